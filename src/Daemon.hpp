@@ -0,0 +1,496 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include <iostream> // std::cout, std::cerr
+#include <fstream> // std::ifstream
+#include <sstream> // std::istringstream, std::ostringstream
+#include <string> // std::string
+#include <vector> // std::vector
+#include <memory> // std::shared_ptr, std::unique_ptr
+#include <mutex> // std::mutex, std::lock_guard, std::unique_lock
+#include <condition_variable> // std::condition_variable
+#include <thread> // std::thread
+#include <atomic> // std::atomic
+#include <unordered_map> // std::unordered_map
+#include <unordered_set> // std::unordered_set
+#include <algorithm> // std::push_heap, std::pop_heap, std::none_of
+#include <filesystem> // std::filesystem
+#include <stdexcept> // std::runtime_error
+#include <cstring> // std::strerror
+#include <cerrno> // errno
+
+#include <sys/socket.h> // socket, bind, listen, accept, connect, send
+#include <sys/un.h> // sockaddr_un
+#include <unistd.h> // read, close, unlink
+
+#include "graphics/TypeNames.hpp"
+#include "graphics/Parallel.hpp"
+#include "Engine.hpp"
+#include "Scene.hpp"
+
+namespace SPGL
+{
+    // One end of a Unix domain socket, read as lines and written to whole
+    // messages at a time from any thread
+    class Connection
+    {
+    private:
+        int _fd;
+        std::string _buffer;
+        std::mutex _write;
+
+    public:
+        explicit Connection(const int fd) : _fd{fd}, _buffer{} {}
+        ~Connection() { if(_fd >= 0) ::close(_fd); }
+
+        Connection(const Connection&) = delete;
+        Connection& operator=(const Connection&) = delete;
+
+        static sockaddr_un address(const std::string& path)
+        {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            if(path.size() >= sizeof(address.sun_path))
+                throw std::runtime_error("Socket path \"" + path + "\" is too long");
+
+            path.copy(address.sun_path, path.size());
+            return address;
+        }
+
+        static std::shared_ptr<Connection> connect(const std::string& path)
+        {
+            const sockaddr_un to = address(path);
+            const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if(fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr*>(&to), sizeof(to)) < 0)
+            {
+                const std::string reason = std::strerror(errno);
+                if(fd >= 0) ::close(fd);
+                throw std::runtime_error("Unable to connect to \"" + path + "\": " + reason);
+            }
+
+            return std::make_shared<Connection>(fd);
+        }
+
+    public:
+        // False once the other end hangs up
+        bool read_line(std::string& line)
+        {
+            for(;;)
+            {
+                const Size end = _buffer.find('\n');
+                if(end != std::string::npos)
+                {
+                    line.assign(_buffer, 0, end);
+                    _buffer.erase(0, end + 1);
+                    return true;
+                }
+
+                if(!fill()) return false;
+            }
+        }
+
+        bool read(std::string& data, const Size size)
+        {
+            while(_buffer.size() < size)
+                if(!fill()) return false;
+
+            data.assign(_buffer, 0, size);
+            _buffer.erase(0, size);
+            return true;
+        }
+
+        bool send(const std::string& message)
+        {
+            const std::lock_guard<std::mutex> guard(_write);
+
+            for(Size sent = 0; sent < message.size();)
+            {
+                const ssize_t count = ::send(_fd, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+                if(count <= 0) return false;
+                sent += Size(count);
+            }
+
+            return true;
+        }
+
+    private:
+        bool fill()
+        {
+            char chunk[1 << 16];
+            const ssize_t count = ::read(_fd, chunk, sizeof(chunk));
+            if(count <= 0) return false;
+
+            _buffer.append(chunk, Size(count));
+            return true;
+        }
+    };
+
+    /**
+     * Renders scripts sent over a Unix domain socket. Every worker keeps
+     * its engines, and with them the decoded skybox, from one job to the
+     * next, along with the last static layer it drew, so small jobs don't
+     * pay for starting up.
+     *
+     * Clients send one request per line and get lines back:
+     *
+     *   render PRIORITY SIZE    followed by SIZE bytes of script
+     *                           -> "queued ID", then once it has run
+     *                              "done ID", "error ID MESSAGE" or
+     *                              "cancelled ID"
+     *   cancel ID               -> "cancelling ID" or "unknown ID"
+     *   jobs                    -> "job ID PRIORITY queued|running" for
+     *                              each job, then "end"
+     *
+     * Higher priorities run first, and equal ones in the order they came
+     * in. Running jobs stop between frames when cancelled, and a client
+     * that hangs up cancels the jobs it sent. Scripts run in the daemon's
+     * working directory, so the files they write end up there. A job
+     * waits to start while another job is writing any of the same files.
+     */
+    class RenderDaemon
+    {
+    private:
+        struct Job
+        {
+            UInt64 id;
+            int priority;
+            std::string script;
+            std::shared_ptr<Connection> client;
+
+            std::atomic<bool> cancelled{false};
+            bool running = false;
+        };
+
+        // Heap order, so the front of the queue is the job to run next
+        struct RunsLater
+        {
+            bool operator()(const std::shared_ptr<Job>& a, const std::shared_ptr<Job>& b) const
+            { return a->priority != b->priority ? a->priority < b->priority : a->id > b->id; }
+        };
+
+    private:
+        std::string _path;
+        Size _workers;
+        Scene::Options _options;
+
+        std::mutex _lock;
+        std::condition_variable _ready;
+        std::vector<std::shared_ptr<Job>> _queue;
+        std::unordered_map<UInt64, std::shared_ptr<Job>> _jobs;
+        UInt64 _next_id;
+
+        // Files running jobs are writing
+        std::condition_variable _released;
+        std::unordered_set<std::string> _writing;
+
+        // Holds a job's output files for as long as it lives
+        class Claim
+        {
+        private:
+            RenderDaemon& _daemon;
+            std::vector<std::string> _names;
+
+        public:
+            // Waits until no other job is writing any of names
+            Claim(RenderDaemon& daemon, const Job& job, std::vector<std::string> names)
+                : _daemon{daemon}, _names{std::move(names)}
+            {
+                std::unique_lock<std::mutex> guard(_daemon._lock);
+                _daemon._released.wait(guard, [&] {
+                    return job.cancelled || std::none_of(_names.begin(), _names.end(), [&](const std::string& name) {
+                        return _daemon._writing.contains(name);
+                    });
+                });
+
+                if(job.cancelled) throw std::runtime_error("Cancelled");
+                _daemon._writing.insert(_names.begin(), _names.end());
+            }
+
+            ~Claim()
+            {
+                {
+                    const std::lock_guard<std::mutex> guard(_daemon._lock);
+                    for(const std::string& name : _names) _daemon._writing.erase(name);
+                }
+
+                _daemon._released.notify_all();
+            }
+
+            Claim(const Claim&) = delete;
+            Claim& operator=(const Claim&) = delete;
+        };
+
+    public:
+        // Jobs render with options, one frame at a time on their worker
+        RenderDaemon(const std::string& path, const Size workers, const Scene::Options& options)
+            : _path{path}, _workers{std::max<Size>(1, workers)}, _options{options}
+            , _queue{}, _jobs{}, _next_id{1}, _writing{}
+        {
+            _options.jobs = 1;
+            _options.stream_path.clear();
+            _options.stream_fd = -1;
+            _options.shard = 0;
+            _options.shards = 1;
+            _options.merge = 0;
+        }
+
+        RenderDaemon(const RenderDaemon&) = delete;
+        RenderDaemon& operator=(const RenderDaemon&) = delete;
+
+        // Serves clients until the socket fails
+        void run()
+        {
+            const sockaddr_un address = Connection::address(_path);
+
+            // A socket left behind by a daemon that didn't shut down is
+            // replaced, but one that still answers belongs to a live daemon
+            std::error_code error;
+            if(std::filesystem::is_socket(_path, error))
+            {
+                bool live = true;
+                try { Connection::connect(_path); }
+                catch(const std::runtime_error&) { live = false; }
+
+                if(live) throw std::runtime_error("A daemon is already listening on \"" + _path + "\"");
+                ::unlink(_path.c_str());
+            }
+
+            const int server = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if(server < 0
+            || ::bind(server, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0
+            || ::listen(server, 64) < 0)
+            {
+                const std::string reason = std::strerror(errno);
+                if(server >= 0) ::close(server);
+                throw std::runtime_error("Unable to listen on \"" + _path + "\": " + reason);
+            }
+
+            for(Size worker = 0; worker < _workers; ++worker)
+                std::thread(&RenderDaemon::work, this).detach();
+
+            std::cerr << "Listening on " << _path << " with " << _workers << " workers\n";
+
+            for(;;)
+            {
+                const int client = ::accept(server, nullptr, nullptr);
+                if(client < 0 && errno == EINTR) continue;
+                if(client < 0) break;
+
+                std::thread(&RenderDaemon::serve, this, std::make_shared<Connection>(client)).detach();
+            }
+
+            const std::string reason = std::strerror(errno);
+            ::close(server);
+            throw std::runtime_error("Stopped accepting on \"" + _path + "\": " + reason);
+        }
+
+    private:
+        void serve(std::shared_ptr<Connection> client)
+        {
+            std::vector<UInt64> sent;
+
+            for(std::string line; client->read_line(line);)
+            {
+                std::istringstream request(line);
+                std::string command;
+                request >> command;
+
+                if(command == "render")
+                {
+                    int priority;
+                    Size size;
+                    std::string script;
+                    if(!(request >> priority >> size))
+                    {
+                        client->send("error 0 Expected \"render PRIORITY SIZE\"\n");
+                        break;
+                    }
+
+                    if(!client->read(script, size)) break;
+                    sent.push_back(enqueue(priority, std::move(script), client));
+                }
+                else if(command == "cancel")
+                {
+                    UInt64 id = 0;
+                    request >> id;
+                    client->send((stop(id) ? "cancelling " : "unknown ") + std::to_string(id) + "\n");
+                }
+                else if(command == "jobs")
+                {
+                    client->send(list() + "end\n");
+                }
+                else if(!command.empty())
+                {
+                    client->send("error 0 Unknown request \"" + command + "\"\n");
+                }
+            }
+
+            for(const UInt64 id : sent) stop(id);
+        }
+
+        UInt64 enqueue(const int priority, std::string script, const std::shared_ptr<Connection>& client)
+        {
+            const auto job = std::make_shared<Job>();
+            job->priority = priority;
+            job->script = std::move(script);
+            job->client = client;
+
+            {
+                const std::lock_guard<std::mutex> guard(_lock);
+                job->id = _next_id++;
+
+                _jobs[job->id] = job;
+                _queue.push_back(job);
+                std::push_heap(_queue.begin(), _queue.end(), RunsLater{});
+
+                // Under the lock, so it goes out before the job can finish
+                client->send("queued " + std::to_string(job->id) + "\n");
+            }
+
+            _ready.notify_one();
+            return job->id;
+        }
+
+        // Queued jobs are dropped right away, running ones after the frame
+        // they are on
+        bool stop(const UInt64 id)
+        {
+            const std::lock_guard<std::mutex> guard(_lock);
+
+            const auto found = _jobs.find(id);
+            if(found == _jobs.end()) return false;
+
+            const std::shared_ptr<Job> job = found->second;
+            job->cancelled = true;
+            _released.notify_all();
+
+            if(!job->running)
+            {
+                _jobs.erase(found);
+                job->client->send("cancelled " + std::to_string(id) + "\n");
+            }
+
+            return true;
+        }
+
+        std::string list()
+        {
+            const std::lock_guard<std::mutex> guard(_lock);
+
+            std::ostringstream out;
+            for(const auto& [id, job] : _jobs)
+                out << "job " << id << " " << job->priority << " " << (job->running ? "running" : "queued") << "\n";
+            return out.str();
+        }
+
+        void work()
+        {
+            // Built up front, so the first job finds it warm too
+            Scene::State state;
+            state.engines.push_back(std::make_unique<Engine>(500, 500, _options.layout));
+
+            for(;;)
+            {
+                std::shared_ptr<Job> job;
+                {
+                    std::unique_lock<std::mutex> guard(_lock);
+                    _ready.wait(guard, [this] { return !_queue.empty(); });
+
+                    std::pop_heap(_queue.begin(), _queue.end(), RunsLater{});
+                    job = std::move(_queue.back());
+                    _queue.pop_back();
+
+                    if(job->cancelled) continue;
+                    job->running = true;
+                }
+
+                const std::string id = std::to_string(job->id);
+                std::string reply = "done " + id;
+
+                try
+                {
+                    Scene::Options options = _options;
+                    options.cancel = &job->cancelled;
+
+                    const Scene scene = Scene::parse(job->script.data(), job->script.size());
+                    const Claim claim(*this, *job, scene.outputs());
+                    scene.render(options, state);
+                }
+                catch(const std::exception& error)
+                {
+                    reply = "error " + id + " " + error.what();
+                }
+
+                {
+                    const std::lock_guard<std::mutex> guard(_lock);
+                    _jobs.erase(job->id);
+                    if(job->cancelled) reply = "cancelled " + id;
+                }
+
+                job->client->send(reply + "\n");
+            }
+        }
+
+    public:
+        // Sends every script to the daemon at path, printing its replies,
+        // and waits for them all to finish. True if they all rendered.
+        static bool submit(const std::string& path, const std::vector<std::string>& scripts, const int priority)
+        {
+            const std::shared_ptr<Connection> daemon = Connection::connect(path);
+
+            for(const std::string& file_name : scripts)
+            {
+                std::ifstream file(file_name, std::ios::binary);
+                if(!file) throw std::runtime_error("Unable to open \"" + file_name + "\"");
+
+                std::ostringstream script;
+                script << file.rdbuf();
+
+                const std::string data = script.str();
+                daemon->send("render " + std::to_string(priority) + " " + std::to_string(data.size()) + "\n" + data);
+            }
+
+            bool rendered = true;
+            Size finished = 0;
+            for(std::string line; finished < scripts.size() && daemon->read_line(line);)
+            {
+                std::cout << line << std::endl;
+                if(line.starts_with("queued ")) continue;
+
+                rendered = rendered && line.starts_with("done ");
+                ++finished;
+            }
+
+            if(finished < scripts.size())
+                throw std::runtime_error("Lost the connection to \"" + path + "\"");
+
+            return rendered;
+        }
+
+        static bool cancel(const std::string& path, const UInt64 id)
+        {
+            const std::shared_ptr<Connection> daemon = Connection::connect(path);
+            daemon->send("cancel " + std::to_string(id) + "\n");
+
+            std::string line;
+            if(!daemon->read_line(line))
+                throw std::runtime_error("Lost the connection to \"" + path + "\"");
+
+            std::cout << line << std::endl;
+            return line.starts_with("cancelling ");
+        }
+    };
+}
@@ -23,6 +23,12 @@
 #include "graphics/drawers/Line.hpp"
 #include "graphics/drawers/Triangle.hpp"
 #include "graphics/effects/FXAA.hpp"
+#include "graphics/PingPong.hpp"
+#include "graphics/AsyncOutput.hpp"
+#include "graphics/FrameCache.hpp"
+#include "graphics/formats/PNG.hpp"
+#include "graphics/formats/GIF.hpp"
+#include "graphics/formats/Video.hpp"
 
 #include <iostream>
 #include <fstream>
@@ -33,6 +39,7 @@
 #include <stack>
 
 #include <functional>
+#include <memory>
 #include <chrono>
 
 namespace SPGL
@@ -45,26 +52,45 @@ namespace SPGL
     private:
         Color _color;
         FrameBuffer _scene;
+        PingPong _post;
         std::stack<Mat4d> _transform;
+        std::shared_ptr<const FrameBuffer> _layer;
 
         int tri_count = 0;
 
     public:
-        Engine(Size x, Size y)
+        Engine(Size x, Size y, Layout layout = Layout::Linear)
             : _color{Color::White}
-            , _scene{x, y}
+            , _scene{x, y, layout}
+            , _post{}
             , _transform{} 
+            , _layer{}
         { reset(); }
 
         void reset() 
         {
+            _transform = {};
             for(Size i = 0; i < 64; ++i) 
                 _transform.push(Mat4d::Identity());
+
+            if(_layer) { _scene.copy_pixels(*_layer); return; }
             _scene.reset();
             
             _scene.add_light(Vertex(Vec3d(1, 0.5, 1), 1.0 * Color::White));
         }
 
+        // Everything drawn so far, to share between engines with start_from()
+        std::shared_ptr<const FrameBuffer> snapshot() const
+        { return std::make_shared<const FrameBuffer>(_scene); }
+
+        // Makes every reset() start from layer instead of an empty scene;
+        // null goes back to empty
+        void start_from(std::shared_ptr<const FrameBuffer> layer)
+        {
+            _layer = std::move(layer);
+            reset();
+        }
+
     public:
         const Mat4d& get_transform() const { return _transform.top(); }
         Mat4d& get_transform() { return _transform.top(); }
@@ -78,16 +104,30 @@ namespace SPGL
         void push_transform(const Mat4d& mat)
         { _transform.push(mat); }
 
+        void push_transform()
+        { _transform.push(get_transform()); }
+
         void modify_transform(const Mat4d& mat)
         { get_transform() = get_transform() * mat; }
 
     public:
-        const Image& image() const { return _scene.image(); }
+        const Image& image() { return _scene.resolve(); }
+
+        // The finished frame, built in buffers that are reused every frame
+        const Image& post_process()
+        {
+            FXAA::apply(image(), _post.back());
+            _post.swap();
+            return _post.front();
+        }
 
     public:
         void set_material(SYMTAB* constants)
         { _scene.set_material(constants); }
 
+        void set_material(const Color& ambient, const Color& diffuse, const Color& specular)
+        { _scene.set_material(ambient, diffuse, specular); }
+
     public:
 
         void draw_triangle(const Vec4d& a, const Vec4d& b, const Vec4d& c)
@@ -121,18 +161,142 @@ namespace SPGL
 
         void draw_point(const Vec4d& a) { draw_line(a, a); }
 
+        // size runs along +x, -y and -z from corner
+        void draw_box(const Vec3d& corner, const Vec3d& size)
+        {
+            const Vec3d a = corner;
+            const Vec3d b = a + size * Vec3d(+1, -1, -1);
+
+            Vec3d b1(a.x, a.y, a.z), b2(b.x, a.y, a.z), b3(b.x, a.y, b.z), b4(a.x, a.y, b.z);
+            Vec3d t1(a.x, b.y, a.z), t2(b.x, b.y, a.z), t3(b.x, b.y, b.z), t4(a.x, b.y, b.z);
+
+            draw_quad(b1, b2, b3, b4); draw_quad(t4, t3, t2, t1);
+            draw_quad(b2, b1, t1, t2); draw_quad(b3, b2, t2, t3);
+            draw_quad(b4, b3, t3, t4); draw_quad(b1, b4, t4, t1);
+        }
+
+        void draw_sphere(const Vec3d& pos, const Float64 radius)
+        {
+            const Float64 dp = Math::PI / kSegments;
+            const Float64 dt = Math::PI / kSegments;
+            for(Float64 phi = 0.0; phi < Math::PI; phi += dp)
+            {
+                for(Float64 theta = 0.0; theta <= Math::TAU; theta += dt)
+                {
+                    Vec3d da = pos + radius * Vec3d(
+                        std::cos(phi),
+                        std::sin(phi) * std::cos(theta),
+                        std::sin(phi) * std::sin(theta)
+                    );
+
+                    Vec3d db = pos + radius * Vec3d(
+                        std::cos(phi + dp),
+                        std::sin(phi + dp) * std::cos(theta),
+                        std::sin(phi + dp) * std::sin(theta)
+                    );
+
+                    Vec3d dc = pos + radius * Vec3d(
+                        std::cos(phi + dp),
+                        std::sin(phi + dp) * std::cos(theta + dt),
+                        std::sin(phi + dp) * std::sin(theta + dt)
+                    );
+
+                    Vec3d dd = pos + radius * Vec3d(
+                        std::cos(phi),
+                        std::sin(phi) * std::cos(theta + dt),
+                        std::sin(phi) * std::sin(theta + dt)
+                    );
+
+                    draw_quad(da, db, dc, dd);
+                }
+            }
+        }
+
+        // radius1 is the tube, radius2 the ring it sweeps around
+        void draw_torus(const Vec3d& pos, const Float64 radius1, const Float64 radius2)
+        {
+            const Float64 dp = Math::TAU / kSegments;
+            const Float64 dt = Math::TAU / kSegments;
+            for(Float64 phi = 0.0; phi <= Math::TAU; phi += dp)
+            {
+                for(Float64 theta = 0.0; theta <= Math::TAU; theta += dt)
+                {
+                    Vec3d da = pos + Vec3d(
+                        radius2 * std::cos(phi) + radius1 * std::cos(phi) * std::cos(theta + dt),
+                        radius1 * std::sin(theta + dt),
+                        radius2 * std::sin(phi) + radius1 * std::sin(phi) * std::cos(theta + dt)
+                    );
+
+                    Vec3d db = pos + Vec3d(
+                        radius2 * std::cos(phi + dp) + radius1 * std::cos(phi + dp) * std::cos(theta + dt),
+                        radius1 * std::sin(theta + dt),
+                        radius2 * std::sin(phi + dp) + radius1 * std::sin(phi + dp) * std::cos(theta + dt)
+                    );
+
+                    Vec3d dc = pos + Vec3d(
+                        radius2 * std::cos(phi + dp) + radius1 * std::cos(phi + dp) * std::cos(theta),
+                        radius1 * std::sin(theta),
+                        radius2 * std::sin(phi + dp) + radius1 * std::sin(phi + dp) * std::cos(theta)
+                    );
+
+                    Vec3d dd = pos + Vec3d(
+                        radius2 * std::cos(phi) + radius1 * std::cos(phi) * std::cos(theta),
+                        radius1 * std::sin(theta),
+                        radius2 * std::sin(phi) + radius1 * std::sin(phi) * std::cos(theta)
+                    );
+
+                    draw_quad(da, db, dc, dd);
+                }
+            }
+        }
+
     public:
+        // Appends the finished frame to an animation
+        void save(GIF::Writer& animation)
+        { animation.add_frame(post_process()); }
+
+        // Hands the frame to a background thread for post processing and
+        // output, so the next frame can start rendering right away
+        void save(AsyncOutput& output)
+        { output.push(image()); }
+
         void save(const std::string& file_name)
         {
+            if(file_name.ends_with(".png"))
+            {
+                if(!PNG::save(file_name, post_process()))
+                    std::cerr << "Unable to write \"" << file_name << "\"\n";
+                return;
+            }
+
+            if(file_name.ends_with(".ppm"))
+            {
+                std::ofstream file(file_name, std::ios::binary | std::ios::trunc);
+                file << post_process();
+                file.close();
+
+                if(!file)
+                    std::cerr << "Unable to write \"" << file_name << "\"\n";
+                return;
+            }
+
+            // Anything else is still converted by ImageMagick
             std::string temp_file_name = file_name + ".ppm";
 
             std::ofstream file;
             file.open(temp_file_name.c_str(), std::ios::binary | std::ios::trunc);
-            file << FXAA::apply(image());
+            file << post_process();
             file.close();
 
             std::system(("convert " + temp_file_name + " " + file_name + " && rm -f " + temp_file_name).c_str());
         }
+
+        // Saves the frame and opens it in the system's viewer
+        void display(const std::string& file_name)
+        {
+            save(file_name);
+            std::system(("open " + file_name).c_str());
+        }
     };
 
 }
\ No newline at end of file
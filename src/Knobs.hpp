@@ -0,0 +1,154 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include <string> // std::string
+#include <string_view> // std::string_view
+#include <vector> // std::vector
+#include <optional> // std::optional
+
+#include "graphics/TypeNames.hpp"
+
+namespace SPGL
+{
+    // How a knob moves between the ends of a vary or tween
+    enum class Easing
+    {
+        Linear,
+        EaseIn,   // Starts slow
+        EaseOut,  // Ends slow
+        EaseInOut // Starts and ends slow
+    };
+
+    inline std::optional<Easing> easing(const std::string_view name)
+    {
+        if(name == "linear") return Easing::Linear;
+        if(name == "ease_in") return Easing::EaseIn;
+        if(name == "ease_out") return Easing::EaseOut;
+        if(name == "ease_in_out") return Easing::EaseInOut;
+        return std::nullopt;
+    }
+
+    // Maps t in [0, 1] to how far along the knob is
+    inline Float64 ease(const Easing easing, const Float64 t)
+    {
+        switch(easing)
+        {
+        case Easing::EaseIn: return t * t;
+        case Easing::EaseOut: return t * (2.0 - t);
+        case Easing::EaseInOut: return t * t * (3.0 - 2.0 * t);
+        default: return t;
+        }
+    }
+
+    /**
+     * Every knob of an animation, kept as the commands that move it rather
+     * than as values, so the knobs of a frame are worked out only when
+     * that frame is drawn, in time linear in the number of knobs and the
+     * segments that move them.
+     *
+     * A knob no segment moves keeps its base value, which "set" and
+     * "setknobs" change. A knob with segments takes, in each frame, the
+     * value of the last segment covering that frame. Between and after
+     * segments it holds the end of the last one before; before them all
+     * it holds the start of the first.
+     */
+    class Knobs
+    {
+    public:
+        struct Segment
+        {
+            Float64 start_frame, end_frame;
+            Float64 start_value, end_value;
+            Easing easing = Easing::Linear;
+
+            Float64 value(const Float64 f) const
+            {
+                if(f <= start_frame) return start_value;
+                if(f >= end_frame) return end_value;
+
+                const Float64 t = ease(easing, (f - start_frame) / Float64(end_frame - start_frame));
+                return start_value * (1.0 - t) + end_value * t;
+            }
+        };
+
+    private:
+        std::vector<std::string> _names;
+        std::vector<Float64> _base;
+        std::vector<std::vector<Segment>> _segments;
+
+    public:
+        Knobs() : _names{}, _base{}, _segments{} {}
+
+    public:
+        Size size() const { return _names.size(); }
+        const std::string& name(const Int32 slot) const { return _names[slot]; }
+
+        Int32 add(const std::string_view name, const Float64 base)
+        {
+            _names.emplace_back(name);
+            _base.push_back(base);
+            _segments.emplace_back();
+            return Int32(_names.size() - 1);
+        }
+
+        Float64 base(const Int32 slot) const { return _base[slot]; }
+        void set(const Int32 slot, const Float64 value) { _base[slot] = value; }
+
+        void animate(const Int32 slot, const Segment& segment)
+        { _segments[slot].push_back(segment); }
+
+        Float64 value(const Int32 slot, const int f) const
+        {
+            const std::vector<Segment>& segments = _segments[slot];
+            if(segments.empty()) return _base[slot];
+
+            const Segment* covering = nullptr;
+            const Segment* before = nullptr;
+            const Segment* first = &segments.front();
+
+            for(const Segment& segment : segments)
+            {
+                if(segment.start_frame <= f && f <= segment.end_frame) covering = &segment;
+                else if(segment.end_frame < f && (!before || segment.end_frame >= before->end_frame)) before = &segment;
+                if(segment.start_frame <= first->start_frame) first = &segment;
+            }
+
+            if(covering) return covering->value(f);
+            if(before) return before->end_value;
+            return first->start_value;
+        }
+
+        // Every knob's value in frame f, by slot
+        void values(const int f, std::vector<Float64>& out) const
+        {
+            out.resize(size());
+            for(Size slot = 0; slot < size(); ++slot)
+                out[slot] = value(Int32(slot), f);
+        }
+
+        // Whether a knob has one value in every frame, and which
+        bool fixed(const Int32 slot, Float64& value) const
+        {
+            const std::vector<Segment>& segments = _segments[slot];
+            if(segments.empty()) { value = _base[slot]; return true; }
+
+            value = segments.front().start_value;
+            for(const Segment& segment : segments)
+                if(segment.start_value != value || segment.end_value != value) return false;
+            return true;
+        }
+    };
+}
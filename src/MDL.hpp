@@ -0,0 +1,405 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include <iostream> // std::cerr
+#include <string> // std::string
+#include <fstream> // std::ifstream
+#include <string_view> // std::string_view
+#include <charconv> // std::from_chars
+#include <stdexcept> // std::runtime_error
+#include <unordered_map> // std::unordered_map
+#include <unordered_set> // std::unordered_set
+#include <optional> // std::optional
+
+#include "graphics/TypeNames.hpp"
+#include "graphics/MappedFile.hpp"
+#include "graphics/math/Math.hpp"
+#include "Program.hpp"
+#include "Knobs.hpp"
+
+namespace SPGL
+{
+    // Reader for MDL scripts that builds a Program without the legacy parser
+    namespace MDL
+    {
+        enum class Keyword
+        {
+            None,
+            Light, Constants, SaveCoords, Camera, Ambient,
+            Torus, Sphere, Box, Line, Mesh, Texture,
+            Set, Move, Scale, Rotate, Basename, SaveKnobs, Tween, Frames, Vary,
+            Push, Pop, Save, GenerateRayfiles, Shading, SetKnobs, Focal, Display, Web
+        };
+
+        inline Keyword keyword(const std::string_view word)
+        {
+            static const std::unordered_map<std::string_view, Keyword> KEYWORDS = {
+                {"light", Keyword::Light}, {"constants", Keyword::Constants},
+                {"save_coord_system", Keyword::SaveCoords}, {"camera", Keyword::Camera},
+                {"ambient", Keyword::Ambient},
+                {"torus", Keyword::Torus}, {"sphere", Keyword::Sphere}, {"box", Keyword::Box},
+                {"line", Keyword::Line}, {"mesh", Keyword::Mesh}, {"texture", Keyword::Texture},
+                {"set", Keyword::Set}, {"move", Keyword::Move}, {"scale", Keyword::Scale},
+                {"rotate", Keyword::Rotate}, {"basename", Keyword::Basename},
+                {"save_knobs", Keyword::SaveKnobs}, {"tween", Keyword::Tween},
+                {"frames", Keyword::Frames}, {"vary", Keyword::Vary},
+                {"push", Keyword::Push}, {"pop", Keyword::Pop}, {"save", Keyword::Save},
+                {"generate_rayfiles", Keyword::GenerateRayfiles}, {"shading", Keyword::Shading},
+                {"setknobs", Keyword::SetKnobs}, {"focal", Keyword::Focal},
+                {"display", Keyword::Display}, {"web", Keyword::Web}
+            };
+
+            const auto found = KEYWORDS.find(word);
+            return found == KEYWORDS.end() ? Keyword::None : found->second;
+        }
+
+        struct Token
+        {
+            enum class Type { End, Number, Name, Keyword, Colon };
+
+            Type type = Type::End;
+            std::string_view text;
+            Float64 number = 0.0;
+            Keyword keyword = Keyword::None;
+        };
+
+        /**
+         * Splits a script into tokens without copying it. Tokens are the
+         * same as the legacy lexer's: numbers, names that start with a
+         * letter, keywords, ':' and // comments, which are skipped.
+         */
+        class Lexer
+        {
+        private:
+            const char* _pos;
+            const char* _end;
+            Size _line;
+
+            Token _next;
+
+        public:
+            Lexer(const char* data, const Size size)
+                : _pos{data}, _end{data + size}, _line{1}, _next{}
+            { advance(); }
+
+            const Token& peek() const { return _next; }
+            Size line() const { return _line; }
+
+            Token take()
+            {
+                const Token token = _next;
+                advance();
+                return token;
+            }
+
+        private:
+            static bool letter(const char c) { return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z'); }
+            static bool digit(const char c) { return '0' <= c && c <= '9'; }
+
+            void advance()
+            {
+                for(;;)
+                {
+                    while(_pos < _end && (*_pos == ' ' || *_pos == '\t' || *_pos == '\r' || *_pos == '\n'))
+                        if(*_pos++ == '\n') ++_line;
+
+                    if(_end - _pos >= 2 && _pos[0] == '/' && _pos[1] == '/')
+                    {
+                        while(_pos < _end && *_pos != '\n') ++_pos;
+                        continue;
+                    }
+
+                    break;
+                }
+
+                _next = Token{};
+                if(_pos == _end) return;
+
+                const char* start = _pos;
+
+                if(*_pos == ':')
+                {
+                    ++_pos;
+                    _next.type = Token::Type::Colon;
+                }
+                else if(letter(*_pos))
+                {
+                    while(_pos < _end && (letter(*_pos) || digit(*_pos) || *_pos == '_' || *_pos == '.')) ++_pos;
+                    _next.keyword = keyword(std::string_view(start, _pos - start));
+                    _next.type = _next.keyword == Keyword::None ? Token::Type::Name : Token::Type::Keyword;
+                }
+                else if(digit(*_pos) || *_pos == '-' || *_pos == '.')
+                {
+                    const auto parsed = std::from_chars(_pos, _end, _next.number);
+                    if(parsed.ec != std::errc{}) fail(start);
+                    _pos = parsed.ptr;
+                    _next.type = Token::Type::Number;
+                }
+                else fail(start);
+
+                _next.text = std::string_view(start, _pos - start);
+            }
+
+            [[noreturn]] void fail(const char* at) const
+            {
+                const char* stop = at;
+                while(stop < _end && stop - at < 32 && *stop != ' ' && *stop != '\t' && *stop != '\n') ++stop;
+                throw std::runtime_error("Line " + std::to_string(_line) + ": Unexpected \"" + std::string(at, stop) + "\"");
+            }
+        };
+
+        /**
+         * Reads the commands of a script straight into a Program::Builder,
+         * one at a time as they are read. Accepts everything the legacy
+         * grammar does; commands that Program has no instruction for are
+         * read, checked, and skipped with one warning each.
+         *
+         * Throws std::runtime_error naming the line of the first error.
+         */
+        class Parser
+        {
+        private:
+            Lexer _in;
+            Program::Builder& _out;
+            Size _displays;
+            std::unordered_set<std::string_view> _skipped;
+
+        public:
+            Parser(const char* data, const Size size, Program::Builder& out)
+                : _in{data, size}, _out{out}, _displays{0}, _skipped{} {}
+
+            void parse()
+            {
+                while(_in.peek().type != Token::Type::End)
+                    command();
+            }
+
+        private:
+            [[noreturn]] void fail(const std::string& message) const
+            { throw std::runtime_error("Line " + std::to_string(_in.line()) + ": " + message); }
+
+            static std::string describe(const Token& token)
+            {
+                if(token.type == Token::Type::End) return "the end of the file";
+                return "\"" + std::string(token.text) + "\"";
+            }
+
+            Float64 number()
+            {
+                if(_in.peek().type != Token::Type::Number)
+                    fail("Expected a number, found " + describe(_in.peek()));
+                return _in.take().number;
+            }
+
+            Vec3d vec3()
+            {
+                const Float64 x = number(), y = number(), z = number();
+                return Vec3d(x, y, z);
+            }
+
+            std::string_view name()
+            {
+                if(_in.peek().type != Token::Type::Name)
+                    fail("Expected a name, found " + describe(_in.peek()));
+                return _in.take().text;
+            }
+
+            bool has_name() const { return _in.peek().type == Token::Type::Name; }
+            bool has_number() const { return _in.peek().type == Token::Type::Number; }
+
+            // Names of coordinate systems, which nothing draws with yet
+            void optional_name() { if(has_name()) _in.take(); }
+
+            Int32 optional_material()
+            { return has_name() ? _out.material(name()) : IR::DEFAULT_MATERIAL; }
+
+            Int32 optional_knob()
+            { return has_name() ? _out.knob(name()) : IR::NO_KNOB; }
+
+            // Curves are an extension, so scripts without one still work
+            // with the legacy parser
+            Easing optional_easing()
+            {
+                if(!has_name()) return Easing::Linear;
+
+                const std::string_view curve = name();
+                if(const std::optional<Easing> found = easing(curve)) return *found;
+                fail("Unknown easing \"" + std::string(curve) + "\"");
+            }
+
+            void numbers(const Size count) { for(Size i = 0; i < count; ++i) number(); }
+
+            void skip(const std::string_view command)
+            {
+                if(_skipped.insert(command).second)
+                    std::cerr << "Ignoring \"" << command << "\", which can't be drawn yet\n";
+            }
+
+            void command()
+            {
+                const Token token = _in.take();
+                if(token.type != Token::Type::Keyword)
+                    fail("Expected a command, found " + describe(token));
+
+                switch(token.keyword)
+                {
+                case Keyword::Push: _out.add(IR::Push{}); break;
+                case Keyword::Pop: _out.add(IR::Pop{}); break;
+
+                case Keyword::Sphere: {
+                    const Int32 material = optional_material();
+                    const Vec3d center = vec3();
+                    const Float64 radius = number();
+                    optional_name();
+                    _out.add(IR::Sphere{material, center, radius});
+                    } break;
+
+                case Keyword::Torus: {
+                    const Int32 material = optional_material();
+                    const Vec3d center = vec3();
+                    const Float64 r0 = number(), r1 = number();
+                    optional_name();
+                    _out.add(IR::Torus{material, center, r0, r1});
+                    } break;
+
+                case Keyword::Box: {
+                    const Int32 material = optional_material();
+                    const Vec3d corner = vec3(), size = vec3();
+                    optional_name();
+                    _out.add(IR::Box{material, corner, size});
+                    } break;
+
+                case Keyword::Line: {
+                    const Int32 material = optional_material();
+                    const Vec3d a = vec3();
+                    optional_name();
+                    const Vec3d b = vec3();
+                    optional_name();
+                    _out.add(IR::Line{material, a, b});
+                    } break;
+
+                case Keyword::Move: {
+                    const Vec3d offset = vec3();
+                    _out.add(IR::Move{offset, optional_knob()});
+                    } break;
+
+                case Keyword::Scale: {
+                    const Vec3d factor = vec3();
+                    _out.add(IR::Scale{factor, optional_knob()});
+                    } break;
+
+                case Keyword::Rotate: {
+                    const std::string_view axis_name = name();
+                    const Float64 degrees = number();
+                    const Int32 knob = optional_knob();
+
+                    const char axis = axis_name[0] | 0x20;
+                    if(axis < 'x' || 'z' < axis)
+                    {
+                        std::cerr << "Unknown Axis \"" << axis_name << "\". Ignoring...\n";
+                        break;
+                    }
+
+                    _out.add(IR::Rotate{Int32(axis - 'x'), Float64(Math::PI * degrees / 180.0), knob});
+                    } break;
+
+                case Keyword::Constants: {
+                    const std::string_view material = name();
+                    Float64 k[9];
+                    for(Float64& value : k) value = number();
+                    if(has_number()) numbers(3); // Color for flat shading
+
+                    _out.constants(material, IR::Material{
+                        Color(k[0], k[3], k[6]), Color(k[1], k[4], k[7]), Color(k[2], k[5], k[8])
+                    });
+                    } break;
+
+                case Keyword::Basename: _out.basename(name()); break;
+                case Keyword::Frames: _out.frames(int(number())); break;
+
+                case Keyword::Vary: {
+                    const std::string_view knob = name();
+                    const Float64 start_frame = number(), end_frame = number();
+                    const Float64 start_value = number(), end_value = number();
+                    _out.vary(knob, start_frame, end_frame, start_value, end_value, optional_easing());
+                    } break;
+
+                case Keyword::Set: {
+                    const std::string_view knob = name();
+                    _out.set(knob, number());
+                    } break;
+
+                case Keyword::SetKnobs: _out.set_all(number()); break;
+                case Keyword::SaveKnobs: _out.save_knobs(name()); break;
+
+                case Keyword::Tween: {
+                    const Float64 start_frame = number(), end_frame = number();
+                    const std::string_view from = name(), to = name();
+                    if(!_out.tween(start_frame, end_frame, from, to, optional_easing()))
+                        std::cerr << "Unknown knob list \"" << from << "\" or \"" << to << "\" in tween. Ignoring...\n";
+                    } break;
+
+                case Keyword::Save: _out.add(IR::Save{std::string(name())}); break;
+                case Keyword::Display: _out.add(IR::Display{Int32(_displays++)}); break;
+
+                case Keyword::Light: name(); numbers(6); skip(token.text); break;
+                case Keyword::Ambient: numbers(3); skip(token.text); break;
+                case Keyword::Camera: numbers(6); skip(token.text); break;
+                case Keyword::SaveCoords: name(); skip(token.text); break;
+                case Keyword::Texture: name(); numbers(12); skip(token.text); break;
+                case Keyword::Shading: name(); skip(token.text); break;
+                case Keyword::Focal: number(); skip(token.text); break;
+                case Keyword::Web: skip(token.text); break;
+                case Keyword::GenerateRayfiles: skip(token.text); break;
+
+                case Keyword::Mesh: {
+                    optional_name();
+                    if(_in.take().type != Token::Type::Colon) fail("Expected \":\" before the mesh file");
+                    name();
+                    optional_name();
+                    skip(token.text);
+                    } break;
+
+                case Keyword::None: break;
+                }
+            }
+        };
+
+        // Parses a script held in memory
+        inline Program parse(const char* data, const Size size)
+        {
+            Program::Builder builder;
+            Parser(data, size, builder).parse();
+            return builder.finish();
+        }
+
+        // Maps the file instead of reading it, so even very large scripts
+        // are parsed in place
+        inline Program load(const std::string& file_name)
+        {
+            const MappedFile file(file_name);
+            if(!file.good())
+            {
+                if(std::ifstream(file_name).good()) return parse("", 0);
+                throw std::runtime_error("Unable to open \"" + file_name + "\"");
+            }
+
+            try { return parse(reinterpret_cast<const char*>(file.data()), file.size()); }
+            catch(const std::runtime_error& error)
+            { throw std::runtime_error(file_name + ": " + error.what()); }
+        }
+    }
+}
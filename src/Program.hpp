@@ -0,0 +1,477 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include <iostream> // std::cerr
+#include <string> // std::string
+#include <vector> // std::vector
+#include <variant> // std::variant, std::visit
+#include <optional> // std::optional
+#include <type_traits> // std::is_same_v, std::decay_t
+#include <string_view> // std::string_view
+#include <unordered_map> // std::unordered_map
+#include <algorithm> // std::max
+#include <cmath> // std::lround
+
+#include "legacy/parser.h"
+#include "legacy/symtab.h"
+#include "legacy/y.tab.h"
+
+#include "graphics/math/Math.hpp"
+#include "graphics/math/Vector3D.hpp"
+#include "graphics/math/Matrix4D.hpp"
+#include "graphics/TypeNames.hpp"
+#include "graphics/Color.hpp"
+#include "Knobs.hpp"
+
+namespace SPGL
+{
+    // Compiled form of an MDL script
+    namespace IR
+    {
+        // Knob slot of a command that isn't scaled by a knob
+        constexpr Int32 NO_KNOB = -1;
+
+        struct Push {};
+        struct Pop {};
+
+        // Lighting constants of a surface; primitives refer to them by index
+        struct Material
+        {
+            Color ambient = Color(0.1, 0.1, 0.1);
+            Color diffuse = Color(0.8, 0.8, 0.8);
+            Color specular = Color(0.3, 0.3, 0.3);
+        };
+
+        // Material of primitives that don't name one
+        constexpr Int32 DEFAULT_MATERIAL = 0;
+
+        struct Line { Int32 material; Vec3d a, b; };
+        struct Box { Int32 material; Vec3d corner, size; };
+        struct Sphere { Int32 material; Vec3d center; Float64 radius; };
+        struct Torus { Int32 material; Vec3d center; Float64 r0, r1; };
+
+        // Transforms scaled by their knob's value k in the frame
+        struct Move
+        {
+            Vec3d offset; Int32 knob;
+            Mat4d matrix(const Float64 k) const { return Mat4d::Translation(offset * k); }
+        };
+
+        struct Scale
+        {
+            Vec3d factor; Int32 knob;
+            Mat4d matrix(const Float64 k) const { return Mat4d::Scale(factor * k); }
+        };
+
+        struct Rotate
+        {
+            Int32 axis; Float64 radians; Int32 knob;
+            Mat4d matrix(const Float64 k) const
+            {
+                /**/ if(axis == 0) return Mat4d::RotX(radians * k);
+                else if(axis == 1) return Mat4d::RotY(radians * k);
+                else               return Mat4d::RotZ(radians * k);
+            }
+        };
+
+        // A run of transforms that are the same in every frame
+        struct Transform { Mat4d matrix; };
+
+        struct Save { std::string file_name; };
+        struct Display { Int32 index; };
+
+        using Instruction = std::variant<
+            Push, Pop,
+            Line, Box, Sphere, Torus,
+            Move, Scale, Rotate, Transform,
+            Save, Display
+        >;
+    }
+
+    /**
+     * A script ready to draw. Every knob a command uses gets a slot, and
+     * the knobs of a frame are worked out into one value per slot when the
+     * frame is drawn, so drawing never looks anything up by name, and
+     * frames that are never drawn cost nothing.
+     */
+    class Program
+    {
+    public:
+        // Which primitives a pass over the code draws
+        enum class Layer
+        {
+            All,
+            Static, // Only primitives drawn the same way in every frame
+            Dynamic // Only the rest
+        };
+
+        class Builder;
+
+    private:
+        std::string _basename;
+        int _frames;
+
+        std::vector<IR::Instruction> _code;
+        std::vector<IR::Instruction> _static_code, _dynamic_code;
+        std::vector<IR::Material> _materials;
+        Knobs _knobs;
+
+    public:
+        Program()
+            : _basename{"default"}, _frames{1}
+            , _code{}, _static_code{}, _dynamic_code{}
+            , _materials(1), _knobs{} {}
+
+        // Reads the first count commands the legacy parser put in ops
+        static Program compile(const struct command* ops, const int count);
+
+    private:
+        /**
+         * Multiplies every run of transforms that don't change between
+         * frames into one matrix, so they are built once instead of every
+         * frame. Knobs that hold one value for the whole animation count
+         * as unchanging.
+         */
+        void fold()
+        {
+            const auto fixed = [&](const Int32 slot, Float64& value) {
+                value = 1.0;
+                return slot == IR::NO_KNOB || _knobs.fixed(slot, value);
+            };
+
+            std::vector<IR::Instruction> folded;
+            folded.reserve(_code.size());
+
+            for (IR::Instruction& instruction : _code)
+            {
+                const auto matrix = std::visit([&](const auto& command) -> std::optional<Mat4d> {
+                    using T = std::decay_t<decltype(command)>;
+                    if constexpr (std::is_same_v<T, IR::Move> || std::is_same_v<T, IR::Scale> || std::is_same_v<T, IR::Rotate>)
+                    {
+                        Float64 value;
+                        if (fixed(command.knob, value)) return command.matrix(value);
+                    }
+                    return std::nullopt;
+                }, instruction);
+
+                if (!matrix) folded.push_back(std::move(instruction));
+                else if (!folded.empty() && std::holds_alternative<IR::Transform>(folded.back()))
+                {
+                    Mat4d& run = std::get<IR::Transform>(folded.back()).matrix;
+                    run = run * *matrix;
+                }
+                else folded.push_back(IR::Transform{ *matrix });
+            }
+
+            _code = std::move(folded);
+        }
+
+        /**
+         * Sorts primitives by whether anything about them changes between
+         * frames, which is whether any transform under them on the stack
+         * uses a knob. Both layers keep every stack and transform command,
+         * so primitives still end up where they would in one pass.
+         *
+         * The depth test keeps whichever of two nearly equal depths came
+         * first, so only static primitives drawn before the first moving
+         * one go in the static layer. Later ones are drawn with the moving
+         * ones, which keeps every primitive in its original order.
+         *
+         * Scripts that save images part way through a frame are drawn in
+         * one pass, since those images must not show what comes later.
+         */
+        void split()
+        {
+            const auto primitive = [](const IR::Instruction& instruction) {
+                return std::holds_alternative<IR::Line>(instruction) || std::holds_alternative<IR::Box>(instruction)
+                    || std::holds_alternative<IR::Sphere>(instruction) || std::holds_alternative<IR::Torus>(instruction);
+            };
+
+            // Whether each level of the stack changes between frames,
+            // following the 64 levels Engine starts with
+            std::vector<bool> moving(64, false);
+            bool any_static = false, any_moving = false;
+
+            for (const IR::Instruction& instruction : _code)
+            {
+                if (std::holds_alternative<IR::Save>(instruction) || std::holds_alternative<IR::Display>(instruction))
+                {
+                    _static_code.clear();
+                    _dynamic_code.clear();
+                    return;
+                }
+
+                if (std::holds_alternative<IR::Push>(instruction)) moving.push_back(moving.back());
+                else if (std::holds_alternative<IR::Pop>(instruction))
+                {
+                    if (moving.size() > 1) moving.pop_back();
+                    else moving.back() = false;
+                }
+                else if (std::holds_alternative<IR::Move>(instruction) || std::holds_alternative<IR::Scale>(instruction)
+                      || std::holds_alternative<IR::Rotate>(instruction)) moving.back() = true;
+
+                const bool drawn = primitive(instruction);
+                any_moving |= drawn && moving.back();
+                any_static |= drawn && !any_moving;
+
+                if (!drawn || !any_moving) _static_code.push_back(instruction);
+                if (!drawn || any_moving) _dynamic_code.push_back(instruction);
+            }
+
+            if (_frames < 2 || !any_static)
+            {
+                _static_code.clear();
+                _dynamic_code.clear();
+            }
+        }
+
+    public:
+        const std::string& basename() const { return _basename; }
+        int frames() const { return _frames; }
+
+        const std::vector<IR::Instruction>& code(const Layer layer = Layer::All) const
+        {
+            if (layer == Layer::Static) return _static_code;
+            if (layer == Layer::Dynamic) return _dynamic_code;
+            return _code;
+        }
+
+        // Whether drawing the static layer once and every frame on top of
+        // it saves anything
+        bool layered() const { return !_static_code.empty(); }
+        const IR::Material& material(const Int32 index) const { return _materials[index]; }
+        const Knobs& knobs() const { return _knobs; }
+
+        // Every knob's value in frame f, by slot
+        void knobs(const int f, std::vector<Float64>& values) const { _knobs.values(f, values); }
+
+        static Float64 knob(const Float64* values, const Int32 slot)
+        { return slot == IR::NO_KNOB ? 1.0 : values[slot]; }
+    };
+
+    /**
+     * Puts a program together one command at a time, in script order.
+     * Knobs and materials get a slot when first named, whatever names
+     * them, so a script may use a knob before the vary that drives it, or
+     * a material before its constants. set, setknobs and save_knobs act in
+     * script order, so a tween only sees knob lists saved before it.
+     */
+    class Program::Builder
+    {
+    private:
+        Program _program;
+        std::unordered_map<std::string, Int32> _knobs;
+        std::unordered_map<std::string, Int32> _materials;
+        std::vector<bool> _defined;
+
+        // Knob values saved by save_knobs, by slot, and the value knobs
+        // start at until set
+        std::unordered_map<std::string, std::vector<Float64>> _lists;
+        Float64 _default;
+
+    public:
+        Builder()
+            : _program{}, _knobs{}, _materials{}, _defined(1, true)
+            , _lists{}, _default{1.0} {}
+
+    public:
+        void basename(const std::string_view name) { _program._basename = name; }
+        void frames(const int frames) { _program._frames = std::max(1, frames); }
+
+        // Slot of a knob, which starts at 1, or the last setknobs value
+        Int32 knob(const std::string_view name)
+        {
+            const auto [found, added] = _knobs.try_emplace(std::string(name), Int32(_program._knobs.size()));
+            if (added) _program._knobs.add(name, _default);
+            return found->second;
+        }
+
+        // Index of a material, which is the default until defined
+        Int32 material(const std::string_view name)
+        {
+            const auto [found, added] = _materials.try_emplace(std::string(name), Int32(_program._materials.size()));
+            if (added) { _program._materials.emplace_back(); _defined.push_back(false); }
+            return found->second;
+        }
+
+        // Only the first definition of a material counts
+        void constants(const std::string_view name, const IR::Material& material)
+        {
+            const Int32 index = this->material(name);
+            if (_defined[index]) return;
+
+            _program._materials[index] = material;
+            _defined[index] = true;
+        }
+
+        // Where segments of one knob overlap, the later one wins
+        void vary(const std::string_view name, const Float64 start_frame, const Float64 end_frame,
+                  const Float64 start_value, const Float64 end_value, const Easing easing = Easing::Linear)
+        { _program._knobs.animate(knob(name), Knobs::Segment{start_frame, end_frame, start_value, end_value, easing}); }
+
+        // Base values are the ones knobs keep in frames nothing varies
+        void set(const std::string_view name, const Float64 value)
+        { _program._knobs.set(knob(name), value); }
+
+        // Sets every knob so far, and every knob named from now on
+        void set_all(const Float64 value)
+        {
+            _default = value;
+            for (Size slot = 0; slot < _program._knobs.size(); ++slot)
+                _program._knobs.set(Int32(slot), value);
+        }
+
+        void save_knobs(const std::string_view list)
+        {
+            std::vector<Float64>& values = _lists[std::string(list)];
+            values.resize(_program._knobs.size());
+            for (Size slot = 0; slot < values.size(); ++slot)
+                values[slot] = _program._knobs.base(Int32(slot));
+        }
+
+        // Moves every knob saved in from to its value in to. Knobs to
+        // doesn't have stay where they are. False if either list was never
+        // saved.
+        bool tween(const Float64 start_frame, const Float64 end_frame,
+                   const std::string_view from, const std::string_view to, const Easing easing = Easing::Linear)
+        {
+            const auto start = _lists.find(std::string(from));
+            const auto end = _lists.find(std::string(to));
+            if (start == _lists.end() || end == _lists.end()) return false;
+
+            for (Size slot = 0; slot < start->second.size(); ++slot)
+            {
+                const Float64 start_value = start->second[slot];
+                const Float64 end_value = slot < end->second.size() ? end->second[slot] : start_value;
+                _program._knobs.animate(Int32(slot), Knobs::Segment{start_frame, end_frame, start_value, end_value, easing});
+            }
+
+            return true;
+        }
+
+        void add(IR::Instruction instruction) { _program._code.push_back(std::move(instruction)); }
+
+        Program finish()
+        {
+            Program& program = _program;
+            program.fold();
+            program.split();
+            return std::move(program);
+        }
+    };
+
+    inline Program Program::compile(const struct command* ops, const int count)
+    {
+        Builder builder;
+
+        const auto knob = [&](const SYMTAB* p) {
+            return p == NULL ? IR::NO_KNOB : builder.knob(p->name);
+        };
+
+        const auto material = [&](const SYMTAB* p) {
+            if (p == NULL) return IR::DEFAULT_MATERIAL;
+            if (p->type == SYM_CONSTANTS && p->s.c != NULL)
+            {
+                const struct constants& c = *p->s.c;
+                builder.constants(p->name, IR::Material{
+                    Color(c.r[0], c.g[0], c.b[0]), Color(c.r[1], c.g[1], c.b[1]), Color(c.r[2], c.g[2], c.b[2])
+                });
+            }
+            return builder.material(p->name);
+        };
+
+        for (int i = 0; i < count; ++i)
+        {
+            const struct command& command = ops[i];
+
+            switch (command.opcode)
+            {
+            case BASENAME: builder.basename(command.op.basename.p->name); break;
+            case FRAMES: builder.frames(int(command.op.frames.num_frames)); break;
+
+            case VARY: {
+                const auto& vary = command.op.vary;
+                builder.vary(vary.p->name, vary.start_frame, vary.end_frame, vary.start_val, vary.end_val);
+                } break;
+
+            case PUSH: builder.add(IR::Push{}); break;
+            case POP: builder.add(IR::Pop{}); break;
+
+            case LINE: {
+                builder.add(IR::Line{
+                    material(command.op.line.constants), Vec3d(command.op.line.p0), Vec3d(command.op.line.p1)
+                });
+                } break;
+
+            case BOX: {
+                builder.add(IR::Box{
+                    material(command.op.box.constants), Vec3d(command.op.box.d0), Vec3d(command.op.box.d1)
+                });
+                } break;
+
+            case SPHERE: {
+                builder.add(IR::Sphere{
+                    material(command.op.sphere.constants), Vec3d(command.op.sphere.d), command.op.sphere.r
+                });
+                } break;
+
+            case TORUS: {
+                builder.add(IR::Torus{
+                    material(command.op.torus.constants), Vec3d(command.op.torus.d),
+                    command.op.torus.r0, command.op.torus.r1
+                });
+                } break;
+
+            case MOVE: builder.add(IR::Move{ Vec3d(command.op.move.d), knob(command.op.move.p) }); break;
+            case SCALE: builder.add(IR::Scale{ Vec3d(command.op.scale.d), knob(command.op.scale.p) }); break;
+
+            case ROTATE: {
+                const int axis = std::lround(command.op.rotate.axis);
+                if (axis < 0 || 2 < axis)
+                {
+                    std::cerr << "Unknown Axis \"" << axis << "\". Ignoring...\n";
+                    break;
+                }
+
+                builder.add(IR::Rotate{
+                    axis, Float64(Math::PI * command.op.rotate.degrees / 180.0), knob(command.op.rotate.p)
+                });
+                } break;
+
+            case SAVE: builder.add(IR::Save{ command.op.save.p->name }); break;
+            case DISPLAY: builder.add(IR::Display{ i }); break;
+
+            case SET: builder.set(command.op.set.p->name, command.op.set.val); break;
+            case SETKNOBS: builder.set_all(command.op.setknobs.value); break;
+            case SAVE_KNOBS: builder.save_knobs(command.op.save_knobs.p->name); break;
+
+            case TWEEN: {
+                const auto& tween = command.op.tween;
+                if (!builder.tween(tween.start_frame, tween.end_frame, tween.knob_list0->name, tween.knob_list1->name))
+                    std::cerr << "Unknown knob list \"" << tween.knob_list0->name << "\" or \"" << tween.knob_list1->name << "\" in tween. Ignoring...\n";
+                } break;
+
+            case CONSTANTS: break;
+
+            default: {
+                std::cerr << "Unknown OP Code: " << command.opcode << "\n";
+                } break;
+            }
+        }
+
+        return builder.finish();
+    }
+}
@@ -0,0 +1,434 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include <iostream> // std::cout, std::cerr
+#include <string> // std::string
+#include <vector> // std::vector
+#include <memory> // std::unique_ptr, std::shared_ptr
+#include <mutex> // std::mutex, std::lock_guard
+#include <atomic> // std::atomic
+#include <variant> // std::visit, std::holds_alternative, std::get_if
+#include <algorithm> // std::any_of, std::count
+#include <unordered_set> // std::unordered_set
+#include <stdexcept> // std::runtime_error
+#include <cstdlib> // std::system
+
+#include "legacy/parser.h"
+#include "legacy/symtab.h"
+
+#include "graphics/Parallel.hpp"
+#include "Engine.hpp"
+#include "Program.hpp"
+#include "MDL.hpp"
+
+namespace SPGL
+{
+    // Where a script's display command n puts the image it opens
+    inline std::string display_file_name(const Program& program, const Int32 index)
+    { return ".display_tmp_" + program.basename() + "_" + std::to_string(index) + ".ppm"; }
+
+    // Draws one frame of a program into engine, one visit per instruction.
+    // Hashing a frame runs the same visits against a FrameHash instead.
+    template<class Target>
+    struct FrameDrawer
+    {
+        Target& engine;
+        const Program& program;
+        const Float64* knobs;
+
+        void material(const Int32 index)
+        {
+            const IR::Material& material = program.material(index);
+            engine.set_material(material.ambient, material.diffuse, material.specular);
+        }
+
+        void operator()(const IR::Push&) { engine.push_transform(); }
+        void operator()(const IR::Pop&) { engine.pop_transform(); }
+
+        void operator()(const IR::Line& line) { material(line.material); engine.draw_line(line.a, line.b); }
+        void operator()(const IR::Box& box) { material(box.material); engine.draw_box(box.corner, box.size); }
+        void operator()(const IR::Sphere& sphere) { material(sphere.material); engine.draw_sphere(sphere.center, sphere.radius); }
+        void operator()(const IR::Torus& torus) { material(torus.material); engine.draw_torus(torus.center, torus.r0, torus.r1); }
+
+        void operator()(const IR::Scale& scale) { engine.modify_transform(scale.matrix(Program::knob(knobs, scale.knob))); }
+        void operator()(const IR::Move& move) { engine.modify_transform(move.matrix(Program::knob(knobs, move.knob))); }
+        void operator()(const IR::Rotate& rotate) { engine.modify_transform(rotate.matrix(Program::knob(knobs, rotate.knob))); }
+        void operator()(const IR::Transform& transform) { engine.modify_transform(transform.matrix); }
+
+        void operator()(const IR::Display& display)
+        { engine.display(display_file_name(program, display.index)); }
+
+        void operator()(const IR::Save& save) { engine.save(save.file_name); }
+    };
+
+    // Takes the place of an Engine and hashes every call made to it, so
+    // frames that would be drawn the same hash the same
+    class FrameHash
+    {
+    private:
+        // Tells apart calls whose arguments happen to line up
+        enum Call : UInt8 { Push, Pop, Transform, Material, Line, Box, Sphere, Torus, Save, Display };
+
+        Hash64& _hash;
+
+        void vec(const Vec3d& v) { _hash << v.x << v.y << v.z; }
+        void vec(const Vec4d& v) { _hash << v.x << v.y << v.z << v.w; }
+        void color(const Color& c) { _hash << c.r << c.g << c.b; }
+
+    public:
+        explicit FrameHash(Hash64& hash) : _hash{hash} {}
+
+        void push_transform() { _hash << Push; }
+        void pop_transform() { _hash << Pop; }
+        void modify_transform(const Mat4d& matrix) { _hash << Transform << matrix; }
+
+        void set_material(const Color& ambient, const Color& diffuse, const Color& specular)
+        { _hash << Material; color(ambient); color(diffuse); color(specular); }
+
+        void draw_line(const Vec4d& a, const Vec4d& b) { _hash << Line; vec(a); vec(b); }
+        void draw_box(const Vec3d& corner, const Vec3d& size) { _hash << Box; vec(corner); vec(size); }
+        void draw_sphere(const Vec3d& center, const Float64 radius) { _hash << Sphere; vec(center); _hash << radius; }
+        void draw_torus(const Vec3d& center, const Float64 r0, const Float64 r1) { _hash << Torus; vec(center); _hash << r0 << r1; }
+
+        void save(const std::string& file_name) { _hash << Save << file_name; }
+        void display(const std::string& file_name) { _hash << Display << file_name; }
+    };
+
+    /**
+     * One script, ready to render. A Scene owns its program, and with it
+     * every command, knob and material the script named, so any number of
+     * scenes can be loaded and rendered at once from different threads.
+     */
+    class Scene
+    {
+    public:
+        // How render() writes its frames
+        struct Options
+        {
+            // Streams frames here instead of writing images, "-" for stdout
+            std::string stream_path;
+            Video::Format stream_format = Video::Format::Y4M;
+
+            // Descriptor to stream to when it was set up before parsing
+            int stream_fd = -1;
+
+            // Frames rendered at once
+            int jobs = int(Parallel::threads());
+
+            // How engines store pixels while drawing
+            Layout layout = Layout::Linear;
+
+            // Renders only this share of the frames
+            int shard = 0, shards = 1;
+
+            // Joins this many shard outputs instead of rendering
+            int merge = 0;
+
+            // Directory of encoded animation frames to reuse, empty for none
+            std::string cache_path = ".frame_cache";
+
+            // Bytes the cache may hold before old frames are removed
+            UInt64 cache_limit = FrameCache::DEFAULT_LIMIT;
+
+            // Stops the render between frames once set
+            const std::atomic<bool>* cancel = nullptr;
+        };
+
+        // What render() keeps from one call to the next, so a caller that
+        // renders again and again only redoes what changed
+        struct State
+        {
+            std::vector<std::unique_ptr<Engine>> engines;
+
+            // The static layer last drawn, by its hash
+            std::shared_ptr<const FrameBuffer> layer;
+            UInt64 layer_hash = 0;
+
+            // When set, frames of scripts that save files are skipped if
+            // they hash the same as in the last render, since the files
+            // they wrote still hold. Their animation frames are copied from
+            // the last render, since the GIF is written again each time.
+            bool incremental = false;
+            std::vector<UInt64> frames;
+            std::vector<std::vector<UInt8>> encoded;
+        };
+
+    private:
+        Program _program;
+
+    public:
+        explicit Scene(Program program) : _program{std::move(program)} {}
+
+        static Scene load(const std::string& file_name) { return Scene(MDL::load(file_name)); }
+        static Scene parse(const char* data, const Size size) { return Scene(MDL::parse(data, size)); }
+
+        // Reads the script with the flex / bison parser, which fills shared
+        // globals, so legacy scenes are loaded one at a time
+        static Scene load_legacy(const std::string& file_name)
+        {
+            static std::mutex lock;
+            const std::lock_guard<std::mutex> guard(lock);
+
+            std::vector<char> name(file_name.begin(), file_name.end());
+            name.push_back('\0');
+
+            if (!parse_legacy(name.data()))
+                throw std::runtime_error("Unable to open \"" + file_name + "\"");
+
+            print_symtab();
+            return Scene(Program::compile(op.data(), lastop));
+        }
+
+    public:
+        const Program& program() const { return _program; }
+
+        // Every file an unsharded render() writes
+        std::vector<std::string> outputs() const
+        {
+            std::vector<std::string> names;
+            if (_program.frames() != 1) names.push_back(_program.basename() + ".gif");
+
+            for (const IR::Instruction& instruction : _program.code())
+            {
+                if (const IR::Save* save = std::get_if<IR::Save>(&instruction)) names.push_back(save->file_name);
+                if (const IR::Display* display = std::get_if<IR::Display>(&instruction)) names.push_back(display_file_name(_program, display->index));
+            }
+
+            return names;
+        }
+
+        // Deterministic so shards rendered anywhere can be merged
+        static std::string shard_name(const std::string& basename, const int shard, const int shards)
+        {
+            return basename + "-shard-" + std::to_string(shard) + "-of-" + std::to_string(shards) + ".gif";
+        }
+
+        // Draws frame f, or just one layer of it
+        void draw(Engine& engine, const int f, const Program::Layer layer = Program::Layer::All) const
+        {
+            engine.reset();
+
+            std::vector<Float64> knobs;
+            _program.knobs(f, knobs);
+
+            FrameDrawer<Engine> drawer{engine, _program, knobs.data()};
+            for (const IR::Instruction& instruction : _program.code(layer))
+                std::visit(drawer, instruction);
+        }
+
+        // Hashes everything that goes into drawing frame f: the calls it
+        // makes to the engine, the sky map they are lit by, and the
+        // version of the code that turns them into pixels
+        UInt64 hash(const int f, const Program::Layer layer = Program::Layer::All) const
+        {
+            Hash64 hash;
+            hash << FrameCache::VERSION << Engine::kSegments;
+            hash.file(FrameBuffer::kSkyFile);
+
+            std::vector<Float64> knobs;
+            _program.knobs(f, knobs);
+
+            FrameHash target{hash};
+            FrameDrawer<FrameHash> hasher{target, _program, knobs.data()};
+            for (const IR::Instruction& instruction : _program.code(layer))
+                std::visit(hasher, instruction);
+
+            return hash.value();
+        }
+
+        void render(const Options& options) const
+        {
+            State state;
+            render(options, state);
+        }
+
+        void render(const Options& options, State& state) const
+        {
+            const Program& program = _program;
+            const std::string& basename = program.basename();
+            const int frames = program.frames();
+
+            std::cout << "Basename = " << basename << std::endl;
+            std::cout << "Number of Frames = " << frames << std::endl;
+
+            if (options.merge > 0)
+            {
+                std::vector<std::string> inputs;
+                for (int shard = 0; shard < options.merge; ++shard)
+                    inputs.push_back(shard_name(basename, shard, options.merge));
+
+                if (!GIF::merge(inputs, basename + ".gif"))
+                    throw std::runtime_error("Unable to merge shards into \"" + basename + ".gif\"");
+
+                std::cerr << "Merged " << options.merge << " shards into " << basename << ".gif\n";
+                return;
+            }
+
+            // Shard i of n renders frames [first, last)
+            const int first = frames * options.shard / options.shards;
+            const int last = frames * (options.shard + 1) / options.shards;
+
+            std::unique_ptr<GIF::Writer> animation;
+            std::unique_ptr<Video::Writer> video;
+            if (!options.stream_path.empty())
+            {
+                video = options.stream_fd >= 0
+                    ? std::make_unique<Video::Writer>(options.stream_fd, options.stream_format, 500, 500)
+                    : std::make_unique<Video::Writer>(options.stream_path, options.stream_format, 500, 500);
+            }
+            else if (frames != 1)
+            {
+                const std::string name = options.shards > 1 ? shard_name(basename, options.shard, options.shards) : basename + ".gif";
+                animation = std::make_unique<GIF::Writer>(name, 500, 500);
+            }
+
+            // Frames are independent, so each worker renders whole frames with its
+            // own Engine. Scripts that save files mid frame keep to one worker so
+            // those files are written in order.
+            const bool saves = std::any_of(program.code().begin(), program.code().end(), [](const IR::Instruction& instruction) {
+                return std::holds_alternative<IR::Save>(instruction) || std::holds_alternative<IR::Display>(instruction);
+            });
+
+            // Animation frames that were encoded before, in an earlier run or
+            // earlier in this one, are copied instead of drawn. Scripts that save
+            // files have to draw every frame to write them, unless they wrote
+            // the same files last render.
+            std::unique_ptr<FrameCache> cache;
+            if (animation && !saves && !options.cache_path.empty())
+                cache = std::make_unique<FrameCache>(options.cache_path, options.cache_limit);
+
+            // A stream has no copy of the last render to take frames from
+            const bool keep = saves && state.incremental && !video;
+            const bool unchanged = keep && Size(frames) == state.frames.size()
+                                && (!animation || Size(frames) == state.encoded.size());
+            std::vector<std::vector<UInt8>> encoded(animation && keep ? frames : 0);
+
+            std::vector<UInt64> hashes(last - first);
+            std::vector<bool> reuse(last - first, false);
+            if (cache || keep)
+            {
+                std::unordered_set<UInt64> seen;
+                for (int i = 0; i < last - first; ++i)
+                {
+                    hashes[i] = hash(first + i);
+
+                    // Cached frames are stored encoded, so the encoder's settings count too
+                    if (cache) hashes[i] = (Hash64() << hashes[i] << animation->delay() << animation->spread()).value();
+                    if (cache) reuse[i] = !seen.insert(hashes[i]).second || cache->contains(hashes[i]);
+                    if (unchanged) reuse[i] = hashes[i] == state.frames[first + i];
+                }
+            }
+
+            state.frames.clear();
+
+            // Declared after everything its tasks use, so if rendering throws,
+            // the tasks already queued finish before any of it is destroyed
+            std::unique_ptr<AsyncOutput> output;
+            if (video) output = std::make_unique<AsyncOutput>([&](const Image& frame) { video->add_frame(frame); });
+            if (animation) output = std::make_unique<AsyncOutput>([&](const Image& frame) { animation->add_frame(frame); });
+
+            const int drawn = int(std::count(reuse.begin(), reuse.end(), false));
+            const Size workers = saves ? 1 : std::max(1, std::min(options.jobs, drawn));
+            std::vector<std::unique_ptr<Engine>>& pool = state.engines;
+            if (drawn > 0)
+                while (pool.size() < workers) pool.push_back(std::make_unique<Engine>(500, 500, options.layout));
+
+            // Primitives that look the same in every frame are drawn once, and
+            // every frame starts from a copy of them, kept for later renders
+            // while they stay the same
+            std::shared_ptr<const FrameBuffer> layer;
+            if (program.layered() && drawn > 0)
+            {
+                const UInt64 layer_hash = hash(first, Program::Layer::Static);
+                if (!state.layer || state.layer_hash != layer_hash)
+                {
+                    pool[0]->start_from(nullptr);
+                    draw(*pool[0], first, Program::Layer::Static);
+                    state.layer = pool[0]->snapshot();
+                    state.layer_hash = layer_hash;
+                }
+                else std::cerr << "Static layer... Unchanged!\n";
+
+                layer = state.layer;
+            }
+
+            if (drawn > 0)
+                for (Size worker = 0; worker < workers; ++worker)
+                    pool[worker]->start_from(layer);
+
+            const Program::Layer pass = layer ? Program::Layer::Dynamic : Program::Layer::All;
+
+            Parallel::ordered(last - first, workers,
+                [&](Size worker, Size i) {
+                    if (options.cancel && *options.cancel)
+                        throw std::runtime_error("Cancelled");
+                    if (reuse[i]) return;
+                    draw(*pool[worker], first + i, pass);
+                },
+                [&](Size worker, Size i) {
+                    const int f = first + i;
+                    const UInt64 hash = hashes[i];
+
+                    if (reuse[i] && !cache)
+                    {
+                        if (animation)
+                        {
+                            output->push([&, f] {
+                                encoded[f] = std::move(state.encoded[f]);
+                                animation->add_encoded(encoded[f].data(), encoded[f].size());
+                            });
+                        }
+                        std::cerr << "Frame " << f << " / " << frames << "... Unchanged!\n";
+                        return;
+                    }
+
+                    if (reuse[i])
+                    {
+                        output->push([&, hash, f] {
+                            std::vector<UInt8> frame;
+                            if (!cache->load(hash, frame))
+                                throw std::runtime_error("Frame " + std::to_string(f) + " is missing from the cache");
+                            animation->add_encoded(frame.data(), frame.size());
+                        });
+                        std::cerr << "Frame " << f << " / " << frames << "... Cached!\n";
+                        return;
+                    }
+
+                    if (output) pool[worker]->save(*output);
+                    if (!encoded.empty())
+                        output->push([&, f] { encoded[f] = animation->last_frame(); });
+                    if (cache)
+                    {
+                        output->push([&, hash] {
+                            const std::vector<UInt8>& frame = animation->last_frame();
+                            cache->store(hash, frame.data(), frame.size());
+                        });
+                    }
+                    std::cerr << "Frame " << f << " / " << frames << "... Done!\n";
+                });
+
+            if (output)
+                output->finish();
+
+            if (keep)
+            {
+                state.frames.assign(frames, 0);
+                std::copy(hashes.begin(), hashes.end(), state.frames.begin() + first);
+                state.encoded = std::move(encoded);
+            }
+        }
+    };
+}
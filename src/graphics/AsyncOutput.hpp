@@ -0,0 +1,181 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include <thread> // std::thread
+#include <mutex> // std::mutex, std::unique_lock
+#include <condition_variable> // std::condition_variable
+#include <functional> // std::function
+#include <exception> // std::exception_ptr
+#include <deque> // std::deque
+#include <vector> // std::vector
+#include <algorithm> // std::max
+
+#include "TypeNames.hpp"
+#include "effects/FXAA.hpp"
+#include "Image.hpp"
+
+namespace SPGL
+{
+    /**
+     * Runs post processing and a sink (encoding, writing) for finished
+     * frames on a background thread, so they overlap with rendering the
+     * next frame. Frames reach the sink in the order they were pushed, and
+     * tasks pushed between them run in that same order on the same thread.
+     *
+     * At most depth frames are held at once, in buffers that are reused;
+     * push() blocks while they are all waiting, which keeps a slow sink
+     * from piling up frames in memory. Anything the sink throws comes back
+     * out of every later push() and finish(), and no more frames are written.
+     */
+    class AsyncOutput
+    {
+    public:
+        using Sink = std::function<void(const Image&)>;
+        using Task = std::function<void()>;
+
+    private:
+        // A frame for the sink, or a task when frame is null
+        struct Entry
+        {
+            Image* frame;
+            Task task;
+        };
+
+        Sink _sink;
+        bool _post_process;
+
+        std::vector<Image> _buffers;
+        std::vector<Image*> _free;
+        std::deque<Entry> _queue;
+
+        std::mutex _lock;
+        std::condition_variable _has_free, _has_work;
+        bool _done;
+        std::exception_ptr _error;
+
+        std::thread _worker;
+
+    public:
+        // With post_process, the sink gets frames after FXAA
+        AsyncOutput(Sink sink, const Size depth = 2, const bool post_process = true)
+            : _sink{std::move(sink)}
+            , _post_process{post_process}
+            , _buffers(std::max<Size>(1, depth))
+            , _free{}, _queue{}
+            , _done{false}, _error{}
+        {
+            for(Image& buffer : _buffers) _free.push_back(&buffer);
+            _worker = std::thread([this] { run(); });
+        }
+
+        AsyncOutput(const AsyncOutput&) = delete;
+        AsyncOutput& operator=(const AsyncOutput&) = delete;
+
+        ~AsyncOutput()
+        {
+            try { finish(); }
+            catch(...) {}
+        }
+
+    public:
+        // Copies frame into a free buffer, waiting for one if needed
+        void push(const Image& frame)
+        {
+            std::unique_lock<std::mutex> guard(_lock);
+            _has_free.wait(guard, [this] { return !_free.empty() || _error; });
+            rethrow();
+
+            Image* buffer = _free.back();
+            _free.pop_back();
+            guard.unlock();
+
+            *buffer = frame;
+
+            guard.lock();
+            _queue.push_back(Entry{buffer, {}});
+            _has_work.notify_one();
+        }
+
+        // Runs task once everything pushed before it is done
+        void push(Task task)
+        {
+            const std::lock_guard<std::mutex> guard(_lock);
+            rethrow();
+
+            _queue.push_back(Entry{nullptr, std::move(task)});
+            _has_work.notify_one();
+        }
+
+        // Waits for every pushed frame to reach the sink
+        void finish()
+        {
+            {
+                const std::lock_guard<std::mutex> guard(_lock);
+                if(_done && !_worker.joinable()) return;
+                _done = true;
+                _has_work.notify_one();
+            }
+
+            if(_worker.joinable()) _worker.join();
+
+            const std::lock_guard<std::mutex> guard(_lock);
+            rethrow();
+        }
+
+    private:
+        void rethrow()
+        {
+            if(_error) std::rethrow_exception(_error);
+        }
+
+        void run()
+        {
+            Image post;
+
+            for(;;)
+            {
+                std::unique_lock<std::mutex> guard(_lock);
+                _has_work.wait(guard, [this] { return !_queue.empty() || _done; });
+                if(_queue.empty()) return;
+
+                Entry entry = std::move(_queue.front());
+                _queue.pop_front();
+                guard.unlock();
+
+                Image* frame = entry.frame;
+                try
+                {
+                    if(!frame) entry.task();
+                    else if(_post_process) { FXAA::apply(*frame, post); _sink(post); }
+                    else _sink(*frame);
+                }
+                catch(...)
+                {
+                    guard.lock();
+                    _error = std::current_exception();
+                    _has_free.notify_all();
+                    return;
+                }
+
+                if(!frame) continue;
+
+                guard.lock();
+                _free.push_back(frame);
+                _has_free.notify_one();
+            }
+        }
+    };
+}
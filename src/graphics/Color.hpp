@@ -18,8 +18,10 @@
 #include <algorithm>
 #include <limits>
 #include <random>
+#include <array>
 
 #include "math/Math.hpp"
+#include "math/FastMath.hpp"
 #include "TypeNames.hpp"
 
 namespace SPGL // Definitions
@@ -120,7 +122,7 @@ namespace SPGL // Definitions
         static Color RandomHue() 
         {
             static std::default_random_engine rng;
-            static std::uniform_real_distribution hue(0, 360);
+            static std::uniform_real_distribution hue(0.0, 360.0);
             return HSV(hue(rng), 1.0, 1.0);
         }
 
@@ -178,22 +180,26 @@ namespace SPGL // Definitions
         { return Color(Math::limit(r), Math::limit(g), Math::limit(b)); }
 
     public: /* Match Function */
-        constexpr RepT luma(const Float gamma = 2.22) const
+        // Luma of a color that has already been raised to gamma
+        static RepT luma_linear(const Color& linear, const Float gamma = 2.22)
         {
-            return std::pow(
-                std::pow(r, gamma) * 0.299 + 
-                std::pow(g, gamma) * 0.587 + 
-                std::pow(b, gamma) * 0.114,
+            return Math::fast_pow(
+                linear.r * 0.299 + 
+                linear.g * 0.587 + 
+                linear.b * 0.114,
                 (1.0 / gamma)
             );
         }
 
-        constexpr Color pow(const Float gamma) const
+        RepT luma(const Float gamma = 2.22) const
+        { return luma_linear(pow(gamma), gamma); }
+
+        Color pow(const Float gamma) const
         {
             return Color(
-                std::pow(r, gamma),
-                std::pow(g, gamma),
-                std::pow(b, gamma)
+                Math::fast_pow(r, gamma),
+                Math::fast_pow(g, gamma),
+                Math::fast_pow(b, gamma)
             );
         }
 
@@ -288,8 +294,51 @@ namespace SPGL // Implementation
 
 namespace SPGL
 {
+    // Table of byte / 255 raised to gamma, so 8-bit sources skip pow entirely
+    class GammaTable
+    {
+    public:
+        constexpr static Float STANDARD_GAMMA = 2.22;
+
+    private:
+        Float _gamma;
+        std::array<Float, 256> _to_linear;
+
+    public:
+        GammaTable(const Float gamma = STANDARD_GAMMA) 
+            : _gamma{gamma}
+        {
+            for(Size i = 0; i < _to_linear.size(); ++i)
+                _to_linear[i] = std::pow(Math::byte_to_float<Float>(i), gamma);
+        }
+
+        static const GammaTable& standard()
+        {
+            static const GammaTable table(STANDARD_GAMMA);
+            return table;
+        }
+
+    public:
+        Float gamma() const { return _gamma; }
+
+        Float operator()(const UInt8 byte) const { return _to_linear[byte]; }
+
+        Color operator()(const Color::Bytes bytes) const
+        { return Color(_to_linear[bytes.r], _to_linear[bytes.g], _to_linear[bytes.b]); }
+    };
+
     struct ColorAverage
     {
+    public:
+        // A color already converted to the space the average is taken in.
+        // Converting once and adding the sample many times avoids calling
+        // pow for every add / sub.
+        struct Sample
+        {
+            Color color;
+            Float weight;
+        };
+
     private:
         bool _luma;
         Float _gamma;
@@ -307,22 +356,79 @@ namespace SPGL
         ColorAverage& operator=(const ColorAverage& other) = default;
 
     public:
-        ColorAverage& add(const Color& color, Float weight = 1.0)
+        Sample sample_linear(const Color& linear) const
+        {
+            const Float weight = _luma ? Color::luma_linear(linear, _gamma) : 1.0;
+            return Sample{ linear * weight, weight };
+        }
+
+        Sample sample(const Color& color) const
+        { return sample_linear(color.pow(_gamma)); }
+
+        Sample sample(const Color::Bytes& bytes) const
+        {
+            if(_gamma == GammaTable::STANDARD_GAMMA)
+                return sample_linear(GammaTable::standard()(bytes));
+            return sample(Color(bytes));
+        }
+
+        // Bulk versions of sample() / result(), written as flat loops over the
+        // channels so they vectorize
+        void sample(const Color* in, Sample* out, const Size n) const
         {
-            if(_luma) weight *= color.luma();
-            _total += weight;
-            _color += weight * color.pow(_gamma);
+            const Float inv_gamma = 1.0 / _gamma;
+            for(Size i = 0; i < n; ++i)
+            {
+                const Float r = Math::fast_pow(in[i].r, _gamma);
+                const Float g = Math::fast_pow(in[i].g, _gamma);
+                const Float b = Math::fast_pow(in[i].b, _gamma);
+                const Float luma = Math::fast_pow(r * 0.299 + g * 0.587 + b * 0.114, inv_gamma);
+                const Float weight = _luma ? luma : 1.0;
+                out[i].color.r = r * weight;
+                out[i].color.g = g * weight;
+                out[i].color.b = b * weight;
+                out[i].weight = weight;
+            }
+        }
+
+        void result(const Sample* sums, Color* out, const Size n) const
+        {
+            const Float inv_gamma = 1.0 / _gamma;
+            for(Size i = 0; i < n; ++i)
+            {
+                const Float inv = 1.0 / Math::clamp_min(sums[i].weight, 1e-300);
+                out[i].r = Math::clamp_max(Math::fast_pow(sums[i].color.r * inv, inv_gamma), 1.0);
+                out[i].g = Math::clamp_max(Math::fast_pow(sums[i].color.g * inv, inv_gamma), 1.0);
+                out[i].b = Math::clamp_max(Math::fast_pow(sums[i].color.b * inv, inv_gamma), 1.0);
+            }
+        }
+
+        ColorAverage& add(const Sample& sample, const Float weight = 1.0)
+        {
+            _total += weight * sample.weight;
+            _color += weight * sample.color;
             return *this;
         }
 
-        ColorAverage& sub(const Color& color, Float weight = 1.0)
+        ColorAverage& sub(const Sample& sample, const Float weight = 1.0)
         {
-            if(_luma) weight *= color.luma();
-            _total -= weight;
-            _color -= weight * color.pow(_gamma);
+            _total -= weight * sample.weight;
+            _color -= weight * sample.color;
             return *this;
         }
 
-        Color result() const { return (_color / _total).pow(1.0 / _gamma); }
+        ColorAverage& add(const Color& color, const Float weight = 1.0)
+        { return add(sample(color), weight); }
+
+        ColorAverage& sub(const Color& color, const Float weight = 1.0)
+        { return sub(sample(color), weight); }
+
+        Sample sum() const { return Sample{ _color, _total }; }
+
+        Color result() const 
+        { 
+            if(_total <= 0.0) return Color::Black;
+            return (_color / _total).pow(1.0 / _gamma); 
+        }
     };
 }
\ No newline at end of file
@@ -0,0 +1,401 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include <vector> // std::vector
+#include <cmath> // std::exp
+
+#include "TypeNames.hpp"
+#include "Parallel.hpp"
+#include "Color.hpp"
+
+namespace SPGL
+{
+    // A 1D, odd length filter centered on its middle tap
+    class Kernel
+    {
+    private:
+        std::vector<Float> _taps;
+        bool _uniform;
+
+    public:
+        Kernel() : _taps{1.0}, _uniform{true} {}
+
+        Kernel(std::vector<Float> taps)
+            : _taps{std::move(taps)}
+            , _uniform{false}
+        {
+            if(_taps.size() % 2 == 0) _taps.push_back(0.0);
+        }
+
+        // Every tap equal to 1, run as a sliding sum
+        static Kernel Box(const int radius)
+        {
+            Kernel kernel;
+            kernel._taps = std::vector<Float>(2 * std::max(radius, 0) + 1, 1.0);
+            kernel._uniform = true;
+            return kernel;
+        }
+
+        static Kernel Gaussian(const Float sigma)
+        {
+            const int radius = std::max(1, int(std::ceil(3.0 * sigma)));
+            std::vector<Float> taps(2 * radius + 1);
+
+            for(int i = -radius; i <= radius; ++i)
+                taps[i + radius] = Math::gauss(i / (std::sqrt(2.0) * sigma));
+
+            return Kernel(std::move(taps));
+        }
+
+    public:
+        int radius() const { return int(_taps.size() / 2); }
+        Size size() const { return _taps.size(); }
+        bool uniform() const { return _uniform; }
+
+        Float operator[](Size i) const { return _taps[i]; }
+    };
+
+    /**
+     * Pixels stored as ColorAverage::Sample (luma weighted linear color plus
+     * weight) so any filter is a plain weighted sum. Resolving divides by the
+     * weight, which also renormalizes the filter near the edges, where pixels
+     * outside the image count as zero.
+     */
+    class SampleBuffer
+    {
+    public:
+        using Sample = ColorAverage::Sample;
+        constexpr static Size CHANNELS = 4;
+
+        static_assert(sizeof(Sample) == CHANNELS * sizeof(Float));
+
+    private:
+        Size _width, _height;
+        std::vector<Sample> _data;
+
+    public:
+        SampleBuffer() : _width{0}, _height{0}, _data{} {}
+
+        SampleBuffer(Size width, Size height)
+            : _width{width}
+            , _height{height}
+            , _data(width * height) {}
+
+    public:
+        Size width()  const { return _width; }
+        Size height() const { return _height; }
+        Size size()   const { return _width * _height; }
+
+        /***/ Sample* data() /***/ { return _data.data(); }
+        const Sample* data() const { return _data.data(); }
+
+        // Rows in memory order as flat arrays of CHANNELS * width() floats
+        /***/ Float* row(Size y) /***/ { return &_data[y * _width].color.r; }
+        const Float* row(Size y) const { return &_data[y * _width].color.r; }
+
+        // Per thread buffers kept between calls, so filtering every frame
+        // stops allocating once the frame size settles. Slot 0 holds the
+        // image being filtered, 1 the middle pass of a separable filter and
+        // 2 the output of a resize.
+        static SampleBuffer& scratch(const Size slot)
+        {
+            thread_local SampleBuffer buffers[3];
+            return buffers[slot];
+        }
+
+        void resize(Size width, Size height)
+        {
+            _width = width;
+            _height = height;
+            _data.resize(width * height);
+        }
+
+        void load(const Color* in, const ColorAverage& space = ColorAverage())
+        {
+            Parallel::for_range(0, _height, [&](Size b, Size e) {
+                space.sample(in + b * _width, data() + b * _width, (e - b) * _width);
+            });
+        }
+
+        void store(Color* out, const ColorAverage& space = ColorAverage()) const
+        {
+            Parallel::for_range(0, _height, [&](Size b, Size e) {
+                space.result(data() + b * _width, out + b * _width, (e - b) * _width);
+            });
+        }
+    };
+}
+
+namespace SPGL
+{
+    namespace Convolution
+    {
+        constexpr Size CHANNELS = SampleBuffer::CHANNELS;
+
+        // out[i] += k * in[i] over n floats
+        void axpy(Float* out, const Float* in, const Float k, const Size n)
+        {
+            for(Size i = 0; i < n; ++i) out[i] += k * in[i];
+        }
+
+        /*** Finite kernels ***/
+
+        // Filters one row of pixels. pad must hold width + 2 * radius pixels.
+        void row(const Float* in, Float* out, Float* pad, const Size width, const Kernel& kernel)
+        {
+            const Size n = CHANNELS * width;
+            const Size r = CHANNELS * kernel.radius();
+
+            std::fill(pad, pad + r, 0.0);
+            std::copy(in, in + n, pad + r);
+            std::fill(pad + r + n, pad + r + n + r, 0.0);
+
+            if(kernel.uniform())
+            {
+                Float sum[CHANNELS] = {};
+                for(Size i = 0; i < 2 * r; i += CHANNELS)
+                    for(Size c = 0; c < CHANNELS; ++c) sum[c] += pad[i + c];
+
+                for(Size i = 0; i < n; i += CHANNELS)
+                {
+                    for(Size c = 0; c < CHANNELS; ++c)
+                    {
+                        sum[c] += pad[i + 2 * r + c];
+                        out[i + c] = kernel[0] * sum[c];
+                        sum[c] -= pad[i + c];
+                    }
+                }
+            }
+            else
+            {
+                std::fill(out, out + n, 0.0);
+                for(Size j = 0; j < kernel.size(); ++j)
+                    axpy(out, pad + CHANNELS * j, kernel[j], n);
+            }
+        }
+
+        void horizontal(const SampleBuffer& in, SampleBuffer& out, const Kernel& kernel)
+        {
+            out.resize(in.width(), in.height());
+
+            Parallel::for_range(0, in.height(), [&](Size b, Size e) {
+                std::vector<Float> pad(CHANNELS * (in.width() + 2 * kernel.radius()));
+                for(Size y = b; y < e; ++y)
+                    row(in.row(y), out.row(y), pad.data(), in.width(), kernel);
+            });
+        }
+
+        // Memory rows run top down, so taps are mirrored to keep the kernel
+        // oriented the same way as Image::get()
+        void vertical(const SampleBuffer& in, SampleBuffer& out, const Kernel& kernel)
+        {
+            out.resize(in.width(), in.height());
+
+            const long height = in.height();
+            const long radius = kernel.radius();
+
+            if(kernel.uniform())
+            {
+                // Sliding sum of whole rows, each thread taking a band of columns
+                Parallel::for_range(0, CHANNELS * in.width(), [&](Size b, Size e) {
+                    std::vector<Float> sum(e - b, 0.0);
+                    for(long y = -radius; y < radius && y < height; ++y)
+                        if(0 <= y) axpy(sum.data(), in.row(y) + b, 1.0, e - b);
+
+                    for(long y = 0; y < height; ++y)
+                    {
+                        if(y + radius < height) axpy(sum.data(), in.row(y + radius) + b, +1.0, e - b);
+                        Float* dst = out.row(y) + b;
+                        for(Size i = 0; i < e - b; ++i) dst[i] = kernel[0] * sum[i];
+                        if(0 <= y - radius) axpy(sum.data(), in.row(y - radius) + b, -1.0, e - b);
+                    }
+                }, 64);
+            }
+            else
+            {
+                Parallel::for_range(0, in.height(), [&](Size b, Size e) {
+                    for(long y = b; y < long(e); ++y)
+                    {
+                        Float* dst = out.row(y);
+                        std::fill(dst, dst + CHANNELS * in.width(), 0.0);
+
+                        for(long j = 0; j < long(kernel.size()); ++j)
+                        {
+                            const long src = y + radius - j;
+                            if(0 <= src && src < height)
+                                axpy(dst, in.row(src), kernel[j], CHANNELS * in.width());
+                        }
+                    }
+                });
+            }
+        }
+
+        void separable(SampleBuffer& buffer, const Kernel& horizontal_kernel, const Kernel& vertical_kernel)
+        {
+            SampleBuffer& temp = SampleBuffer::scratch(1);
+            horizontal(buffer, temp, horizontal_kernel);
+            vertical(temp, buffer, vertical_kernel);
+        }
+
+        /*** Recursive (IIR) gaussian ***/
+
+        /**
+         * Deriche's fourth order recursive gaussian: a causal and an anti
+         * causal filter whose outputs are summed. The cost per pixel does not
+         * depend on sigma, and the impulse response is within 0.05% of the
+         * peak of a true gaussian for sigma >= 2.
+         */
+        struct RecursiveGaussian
+        {
+            constexpr static Size ORDER = 4;
+
+            // y[i] = sum n[k] x[i - k] - sum d[k] y[i - 1 - k]   (causal)
+            // y[i] = sum m[k] x[i + 1 + k] - sum d[k] y[i + 1 + k]   (anti causal)
+            Float n[ORDER], m[ORDER], d[ORDER];
+
+            RecursiveGaussian(const Float sigma)
+            {
+                constexpr Float a0 = 1.680, a1 = 3.735, b0 = 1.783, b1 = 1.723;
+                constexpr Float w0 = 0.6318, w1 = 1.997, c0 = -0.6803, c1 = -0.2598;
+
+                const Float e0 = std::exp(-b0 / sigma), e1 = std::exp(-b1 / sigma);
+                const Float cos0 = std::cos(w0 / sigma), sin0 = std::sin(w0 / sigma);
+                const Float cos1 = std::cos(w1 / sigma), sin1 = std::sin(w1 / sigma);
+
+                n[0] = a0 + c0;
+                n[1] = e1 * (c1 * sin1 - (c0 + 2.0 * a0) * cos1) + e0 * (a1 * sin0 - (2.0 * c0 + a0) * cos0);
+                n[2] = 2.0 * e0 * e1 * ((a0 + c0) * cos1 * cos0 - a1 * cos1 * sin0 - c1 * cos0 * sin1) 
+                     + c0 * e0 * e0 + a0 * e1 * e1;
+                n[3] = e1 * e0 * e0 * (c1 * sin1 - c0 * cos1) + e0 * e1 * e1 * (a1 * sin0 - a0 * cos0);
+
+                d[0] = -2.0 * e1 * cos1 - 2.0 * e0 * cos0;
+                d[1] = 4.0 * cos1 * cos0 * e0 * e1 + e1 * e1 + e0 * e0;
+                d[2] = -2.0 * cos0 * e0 * e1 * e1 - 2.0 * cos1 * e1 * e0 * e0;
+                d[3] = e0 * e0 * e1 * e1;
+
+                m[0] = n[1] - d[0] * n[0];
+                m[1] = n[2] - d[1] * n[0];
+                m[2] = n[3] - d[2] * n[0];
+                m[3] = -d[3] * n[0];
+
+                // Normalize to unit DC gain
+                Float gain = 0.0, denom = 1.0;
+                for(Size k = 0; k < ORDER; ++k) { gain += n[k] + m[k]; denom += d[k]; }
+                for(Size k = 0; k < ORDER; ++k) { n[k] *= denom / gain; m[k] *= denom / gain; }
+            }
+
+            // Filters count pixels of CHANNELS floats. buf must hold count pixels.
+            void line(Float* data, const Size count, Float* buf) const
+            {
+                const long size = count;
+                const auto at = [&](const Float* p, long i, Size c) {
+                    return (0 <= i && i < size) ? p[CHANNELS * i + c] : 0.0;
+                };
+
+                for(long i = 0; i < size; ++i)
+                for(Size c = 0; c < CHANNELS; ++c)
+                {
+                    Float y = 0.0;
+                    for(long k = 0; k < long(ORDER); ++k)
+                        y += n[k] * at(data, i - k, c) - d[k] * at(buf, i - 1 - k, c);
+                    buf[CHANNELS * i + c] = y;
+                }
+
+                Float x[ORDER][CHANNELS] = {}, y[ORDER][CHANNELS] = {};
+                for(long i = size; i-- > 0;)
+                for(Size c = 0; c < CHANNELS; ++c)
+                {
+                    Float sum = 0.0;
+                    for(Size k = 0; k < ORDER; ++k)
+                        sum += m[k] * x[k][c] - d[k] * y[k][c];
+
+                    for(Size k = ORDER - 1; k > 0; --k) 
+                    { x[k][c] = x[k - 1][c]; y[k][c] = y[k - 1][c]; }
+
+                    x[0][c] = data[CHANNELS * i + c];
+                    y[0][c] = sum;
+                    data[CHANNELS * i + c] = buf[CHANNELS * i + c] + sum;
+                }
+            }
+
+            // Runs the recursion down whole rows at once, one band of columns
+            // per thread, so the inner loops are contiguous vector operations.
+            void columns(SampleBuffer& buffer) const
+            {
+                const long height = buffer.height();
+
+                Parallel::for_range(0, CHANNELS * buffer.width(), [&](Size b, Size e) {
+                    const Size count = e - b;
+                    std::vector<Float> causal(count * height);
+                    std::vector<Float> x(count * ORDER, 0.0), y(count * ORDER, 0.0), sum(count);
+
+                    const auto src = [&](long row) { return buffer.row(row) + b; };
+                    const auto out = [&](long row) { return &causal[count * row]; };
+
+                    for(long row = 0; row < height; ++row)
+                    {
+                        Float* dst = out(row);
+                        std::fill(dst, dst + count, 0.0);
+                        for(long k = 0; k < long(ORDER); ++k)
+                        {
+                            if(0 <= row - k) axpy(dst, src(row - k), n[k], count);
+                            if(0 <= row - 1 - k) axpy(dst, out(row - 1 - k), -d[k], count);
+                        }
+                    }
+
+                    // x and y are rings of the last ORDER input and anti causal
+                    // rows, with row r kept in slot r % ORDER
+                    for(long row = height; row-- > 0;)
+                    {
+                        std::fill(sum.begin(), sum.end(), 0.0);
+                        for(Size k = 0; k < ORDER; ++k)
+                        {
+                            const Size slot = count * ((row + 1 + k) % ORDER);
+                            axpy(sum.data(), &x[slot], m[k], count);
+                            axpy(sum.data(), &y[slot], -d[k], count);
+                        }
+
+                        const Size slot = count * (row % ORDER);
+                        Float* dst = src(row);
+                        const Float* acc = out(row);
+                        for(Size i = 0; i < count; ++i)
+                        {
+                            x[slot + i] = dst[i];
+                            y[slot + i] = sum[i];
+                            dst[i] = acc[i] + sum[i];
+                        }
+                    }
+                }, 64);
+            }
+
+            void rows(SampleBuffer& buffer) const
+            {
+                Parallel::for_range(0, buffer.height(), [&](Size b, Size e) {
+                    std::vector<Float> buf(CHANNELS * buffer.width());
+                    for(Size row = b; row < e; ++row)
+                        line(buffer.row(row), buffer.width(), buf.data());
+                });
+            }
+        };
+
+        void recursive_gaussian(SampleBuffer& buffer, const Float sigma)
+        {
+            const RecursiveGaussian filter(sigma);
+            filter.rows(buffer);
+            filter.columns(buffer);
+        }
+    }
+}
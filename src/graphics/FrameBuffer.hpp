@@ -32,8 +32,12 @@ namespace SPGL
 
     struct FrameBuffer
     {
+    public:
+        constexpr static const char* kSkyFile = "./resources/Sky.png";
+
     private:
         Image _img;
+        Image _resolved;
         ZBuffer _zbuf;
         Vec3d _view;
         SkyBox _sky;
@@ -53,11 +57,12 @@ namespace SPGL
         FrameBuffer& operator=(const FrameBuffer& in) = default;
         FrameBuffer& operator=(FrameBuffer&& in) = default;
 
-        FrameBuffer(Size x, Size y)
-            : _img{x, y}
-            , _zbuf{x, y}
+        FrameBuffer(Size x, Size y, Layout layout = Layout::Linear)
+            : _img{x, y, layout}
+            , _resolved{}
+            , _zbuf{x, y, layout}
             , _view{0.0, 0.0, 1.0}
-            , _sky{"./resources/Sky.ppm"}
+            , _sky{kSkyFile}
             , _kA{}, _kD{}, _kS{}
             , _lights{} 
             {
@@ -84,6 +89,14 @@ namespace SPGL
             }
         }
 
+        // Takes the colors and depths drawn into another frame buffer of
+        // the same size, reusing this one's storage
+        void copy_pixels(const FrameBuffer& other)
+        {
+            _img = other._img;
+            _zbuf = other._zbuf;
+        }
+
     public:
         void set_material(SYMTAB* constants)
         {
@@ -102,6 +115,13 @@ namespace SPGL
             }
         }
 
+        void set_material(const Color& ambient, const Color& diffuse, const Color& specular)
+        {
+            _kA = ambient;
+            _kD = diffuse;
+            _kS = specular;
+        }
+
         const Vec3d& view() const { return _view; }
 
         void set_view(const Vec3d& view)
@@ -142,6 +162,14 @@ namespace SPGL
 
         Image& image() { return _img; }
         const Image& image() const { return _img; }
+
+        // The image in Linear layout, converted if it was drawn in another
+        const Image& resolve()
+        {
+            if(_img.layout() == Layout::Linear) return _img;
+            _resolved = _img.to_layout(Layout::Linear);
+            return _resolved;
+        }
     };
 
 }
\ No newline at end of file
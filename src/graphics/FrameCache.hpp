@@ -0,0 +1,236 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include <string> // std::string
+#include <vector> // std::vector
+#include <fstream> // std::ifstream, std::ofstream
+#include <mutex> // std::mutex, std::lock_guard
+#include <unordered_map> // std::unordered_map
+#include <filesystem> // std::filesystem
+#include <type_traits> // std::is_trivially_copyable_v
+#include <cstdio> // std::snprintf
+#include <thread> // std::this_thread
+#include <functional> // std::hash
+#include <algorithm> // std::sort
+#include <chrono> // std::chrono
+
+#include <unistd.h> // getpid
+
+#include "TypeNames.hpp"
+
+namespace SPGL
+{
+    // 64 bit FNV-1a over the bytes of whatever is added
+    class Hash64
+    {
+    private:
+        UInt64 _state;
+
+    public:
+        Hash64() : _state{0xcbf29ce484222325} {}
+
+        Hash64& add(const void* data, const Size size)
+        {
+            const UInt8* bytes = static_cast<const UInt8*>(data);
+            for(Size i = 0; i < size; ++i)
+                _state = (_state ^ bytes[i]) * 0x100000001b3;
+            return *this;
+        }
+
+        template<class T>
+        Hash64& operator<<(const T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>, "Only plain values can be hashed by their bytes");
+            return add(&value, sizeof(value));
+        }
+
+        Hash64& operator<<(const std::string& value)
+        { return add(value.data(), value.size()); }
+
+        // A file read while drawing, by its name, size and last change
+        Hash64& file(const std::string& file_name)
+        {
+            std::error_code error;
+            const auto size = std::filesystem::file_size(file_name, error);
+            const auto time = std::filesystem::last_write_time(file_name, error);
+            return *this << file_name << UInt64(error ? 0 : size) << time.time_since_epoch().count();
+        }
+
+        UInt64 value() const { return _state; }
+    };
+
+    /**
+     * Encoded frames kept on disk by the hash of everything that went
+     * into drawing them, so frames that come out the same are only ever
+     * rendered and encoded once, in this run or any later one.
+     *
+     * Entries are written to a temporary file and renamed into place, so
+     * a run that dies part way leaves only whole frames behind. If the
+     * directory can't be written, entries are kept in memory instead.
+     * Safe to use from any number of threads.
+     *
+     * Once the directory holds more than limit bytes, the entries used
+     * longest ago are removed. Entries used since this cache was opened
+     * are kept, so a render never loses a frame it is about to copy.
+     */
+    class FrameCache
+    {
+    public:
+        // Part of every key. Bump it whenever a change to drawing, post
+        // processing or encoding changes what a frame looks like.
+        constexpr static UInt64 VERSION = 1;
+
+        constexpr static UInt64 DEFAULT_LIMIT = UInt64(256) << 20;
+
+    private:
+        using Clock = std::filesystem::file_time_type::clock;
+
+        std::string _directory;
+        UInt64 _limit;
+        Clock::time_point _opened;
+
+        std::mutex _lock;
+        UInt64 _bytes;
+        std::unordered_map<UInt64, std::vector<UInt8>> _memory;
+        UInt64 _memory_bytes;
+
+    public:
+        explicit FrameCache(const std::string& directory, const UInt64 limit = DEFAULT_LIMIT)
+            : _directory{directory}, _limit{limit}, _opened{Clock::now()}
+            , _bytes{0}, _memory{}, _memory_bytes{0}
+        {
+            std::error_code error;
+            std::filesystem::create_directories(_directory, error);
+            _bytes = evict();
+        }
+
+        FrameCache(const FrameCache&) = delete;
+        FrameCache& operator=(const FrameCache&) = delete;
+
+    public:
+        bool contains(const UInt64 key)
+        {
+            {
+                const std::lock_guard<std::mutex> guard(_lock);
+                if(_memory.contains(key)) return true;
+            }
+
+            return touch(path(key));
+        }
+
+        bool load(const UInt64 key, std::vector<UInt8>& data)
+        {
+            {
+                const std::lock_guard<std::mutex> guard(_lock);
+                const auto found = _memory.find(key);
+                if(found != _memory.end()) { data = found->second; return true; }
+            }
+
+            const std::string name = path(key);
+            std::ifstream file(name, std::ios::binary | std::ios::ate);
+            if(!file) return false;
+            touch(name);
+
+            data.resize(Size(file.tellg()));
+            file.seekg(0);
+            return bool(file.read(reinterpret_cast<char*>(data.data()), data.size()));
+        }
+
+        void store(const UInt64 key, const UInt8* data, const Size size)
+        {
+            // Scenes and processes rendering at once may store the same
+            // frame, so each thread of each process writes its own temporary file
+            const std::string name = path(key);
+            const std::string temp_name = name + "." + std::to_string(::getpid())
+                                        + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".part";
+
+            std::error_code error;
+            {
+                std::ofstream file(temp_name, std::ios::binary | std::ios::trunc);
+                file.write(reinterpret_cast<const char*>(data), size);
+                if(!file) error = std::make_error_code(std::errc::io_error);
+            }
+
+            if(!error) std::filesystem::rename(temp_name, name, error);
+            if(!error)
+            {
+                const std::lock_guard<std::mutex> guard(_lock);
+                if((_bytes += size) > _limit) _bytes = evict();
+                return;
+            }
+
+            std::filesystem::remove(temp_name, error);
+
+            const std::lock_guard<std::mutex> guard(_lock);
+            if(_memory_bytes + size > _limit || _memory.contains(key)) return;
+            _memory[key].assign(data, data + size);
+            _memory_bytes += size;
+        }
+
+    private:
+        // Marks an entry as just used, so it is the last to be evicted
+        bool touch(const std::string& name) const
+        {
+            std::error_code error;
+            std::filesystem::last_write_time(name, Clock::now(), error);
+            return !error;
+        }
+
+        // Removes the entries used longest ago, down to three quarters of
+        // the limit so it doesn't run on every store, and returns the
+        // bytes left. Other processes may share the directory, so its
+        // size is counted again each time.
+        UInt64 evict() const
+        {
+            struct Entry { std::filesystem::path path; Clock::time_point used; UInt64 size; };
+
+            std::vector<Entry> entries;
+            UInt64 bytes = 0;
+
+            std::error_code error;
+            for(const auto& file : std::filesystem::directory_iterator(_directory, error))
+            {
+                if(file.path().extension() != ".frame") continue;
+
+                std::error_code file_error;
+                const UInt64 size = file.file_size(file_error);
+                const Clock::time_point used = file.last_write_time(file_error);
+                if(file_error) continue;
+
+                entries.push_back({file.path(), used, size});
+                bytes += size;
+            }
+
+            if(bytes <= _limit) return bytes;
+
+            std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.used < b.used; });
+            for(const Entry& entry : entries)
+            {
+                if(bytes <= _limit / 4 * 3 || entry.used >= _opened) break;
+                if(std::filesystem::remove(entry.path, error)) bytes -= entry.size;
+            }
+
+            return bytes;
+        }
+
+        std::string path(const UInt64 key) const
+        {
+            char name[17];
+            std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+            return _directory + "/" + name + ".frame";
+        }
+    };
+}
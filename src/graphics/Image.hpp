@@ -19,10 +19,17 @@
 #include <algorithm> // std::copy
 #include <stdexcept> // std::out_of_range
 #include <iterator> // std::reverse_iterator
+#include <functional> // std::function
 
 #include "math/Vector2D.hpp"
 #include "TypeNames.hpp"
+#include "Convolution.hpp"
+#include "ThresholdMap.hpp"
+#include "Resampler.hpp"
+#include "PixelLayout.hpp"
+#include "Parallel.hpp"
 #include "Color.hpp"
+#include "Sampling.hpp"
 
 namespace SPGL // Definitions
 {
@@ -53,9 +60,12 @@ namespace SPGL // Definitions
         bool empty()  const { return (_img_size.x | _img_size.y) == 0; }
         Size size()   const { return _img_size.x * _img_size.y; }
 
+        // Raw storage; only laid out row by row when layout() is Linear
         const value_type* data() const { return _img_data.data(); }
         value_type* data() { return _img_data.data(); }
 
+        Layout layout() const { return _layout.layout(); }
+
     public: /* Constructors */
         // Default Constructor
         Image() {}
@@ -69,9 +79,19 @@ namespace SPGL // Definitions
         // Create Functions
         Image(Size x, Size y, Color color = Color(0,0,0))
             : _img_size{x, y}
+            , _layout{x, y}
             , _img_data{std::vector<Color>(x * y, color)}
             , _garbage{} {}
 
+        Image(Size x, Size y, Layout layout, Color color = Color(0,0,0))
+            : _img_size{x, y}
+            , _layout{x, y, layout}
+            , _img_data{std::vector<Color>(_layout.storage(), color)}
+            , _garbage{} {}
+
+        // Copy of this image stored in another layout
+        Image to_layout(Layout layout) const;
+
     public: /* Accessors */
         /*** Single value indexing ***/
         /***/ value_type& operator[](Size i) /***/ { return _img_data[i]; }
@@ -84,14 +104,17 @@ namespace SPGL // Definitions
         {
             if(width()  <= x) { return _garbage; }
             if(height() <= y) { return _garbage; }
-            return _img_data[(height() - 1 - y) * width() + x];
+            return _img_data[_layout(x, height() - 1 - y)];
         }
 
+        // Out of bounds writes land in _garbage, so reads past the edge
+        // get black instead of whatever was drawn off screen last
         const value_type& get(Size x, Size y) const 
         {
-            if(width()  <= x) { return _garbage; }
-            if(height() <= y) { return _garbage; }
-            return _img_data[(height() - 1 - y) * width() + x];
+            static const value_type blank{};
+            if(width()  <= x) { return blank; }
+            if(height() <= y) { return blank; }
+            return _img_data[_layout(x, height() - 1 - y)];
         }
         
         /***/ value_type& get(Vec2s i)     /***/ { return get(i.x, i.y); }
@@ -106,106 +129,18 @@ namespace SPGL // Definitions
         const value_type& operator()(Vec2s i) const { return get(i.x, i.y); }
 
         value_type interpolate(Vec2d i) const
-        {
-            Float x_f = Math::fpart(i.x);
-            Float y_f = Math::fpart(i.y);
-            
-            Float x_rf = 1.0 - x_f;
-            Float y_rf = 1.0 - y_f;
-
-            Vec2i pos(std::floor(i.x), std::floor(i.y));
-
-            return (
-                x_rf * y_rf * get(pos + Vec2i(0, 0)) +
-                x_f  * y_rf * get(pos + Vec2i(1, 0)) +
-                x_rf * y_f  * get(pos + Vec2i(0, 1)) +
-                x_f  * y_f  * get(pos + Vec2i(1, 1)) 
-            );
-        } 
+        { return Sampling::interpolate(*this, i); }
 
         value_type sample_box(Vec2d beg, Vec2d end) const
-        {
-            if(end.x < beg.x) std::swap(beg.x, end.x);
-            if(end.y < beg.y) std::swap(beg.y, end.y);
-         
-            const Size fy_beg = std::floor(beg.y);
-            const Size fy_end = std::floor(end.y);
-            const Size fx_beg = std::floor(beg.x);
-            const Size fx_end = std::floor(end.x);
-
-            const Float px_beg = 1 + fx_beg - beg.x;
-            const Float py_beg = 1 + fy_beg - beg.y;
-            
-            const Float px_end = end.x - fx_end;
-            const Float py_end = end.y - fy_end;
-
-            ColorAverage color;   
-            
-            color.add(get(fx_beg, fy_beg), px_beg * py_beg);
-            color.add(get(fx_end, fy_beg), px_end * py_beg);
-            color.add(get(fx_beg, fy_end), px_beg * py_end);
-            color.add(get(fx_end, fy_end), px_end * py_end);
-
-            for(Size x = fx_beg + 1; x < fx_end; ++x) 
-            {
-                color.add(get(x, fy_beg), py_beg);
-                color.add(get(x, fy_end), py_end);
-            }
-
-            for(Size y = fy_beg + 1; y < fy_end; ++y) 
-            {
-                color.add(get(fx_beg, y), px_beg);
-                color.add(get(fx_end, y), px_end);
-                for(Size x = fx_beg + 1; x < fx_end; ++x) 
-                    color.add(get(x, y));
-            }
-
-            return color.result();
-        }
+        { return Sampling::sample_box(*this, beg, end); }
 
         value_type sample_box_luma(Vec2d beg, Vec2d end) const
-        {
-            if(end.x < beg.x) std::swap(beg.x, end.x);
-            if(end.y < beg.y) std::swap(beg.y, end.y);
-         
-            const Size fy_beg = std::floor(beg.y);
-            const Size fy_end = std::floor(end.y);
-            const Size fx_beg = std::floor(beg.x);
-            const Size fx_end = std::floor(end.x);
-
-            const Float px_beg = 1 + fx_beg - beg.x;
-            const Float py_beg = 1 + fy_beg - beg.y;
-            
-            const Float px_end = end.x - fx_end;
-            const Float py_end = end.y - fy_end;
-
-            ColorAverage color;   
-            
-            color.add(get(fx_beg, fy_beg), px_beg * py_beg);
-            color.add(get(fx_end, fy_beg), px_end * py_beg);
-            color.add(get(fx_beg, fy_end), px_beg * py_end);
-            color.add(get(fx_end, fy_end), px_end * py_end);
-
-            for(Size x = fx_beg + 1; x < fx_end; ++x) 
-            {
-                color.add(get(x, fy_beg), py_beg);
-                color.add(get(x, fy_end), py_end);
-            }
-
-            for(Size y = fy_beg + 1; y < fy_end; ++y) 
-            {
-                color.add(get(fx_beg, y), px_beg);
-                color.add(get(fx_end, y), px_end);
-                for(Size x = fx_beg + 1; x < fx_end; ++x) 
-                    color.add(get(x, y));
-            }
-
-            return color.result();
-        }
+        { return Sampling::sample_box(*this, beg, end); }
 
     private: /* Raw Data */
-        std::vector<value_type> _img_data;
         Vec2s _img_size;
+        PixelLayout _layout;
+        std::vector<value_type> _img_data;
         Color _garbage;
 
     public: /* Iterators */
@@ -226,13 +161,39 @@ namespace SPGL // Definitions
         auto crend() const { return std::reverse_iterator(std::cbegin(_img_data)); }
 
     public: /* Modifications  */
-        Image dither(const std::function<Color(Color)>, const Color::RepT = 1.0) const;
-        Image dither_fast(const std::function<Color(Color)>) const;
+        // Sets the size and layout, reusing the current allocation when it
+        // is big enough. Pixel values are left unspecified.
+        void reshape(const Size x, const Size y, const Layout layout = Layout::Linear);
+
+        template<class Rounder> Image dither(Rounder rounder, const Color::RepT error_mul = 1.0) const;
+        template<class Rounder> Image dither_fast(Rounder rounder) const;
+        template<class Rounder> Image dither_ordered(Rounder rounder, const Color::RepT spread, 
+                                                     const ThresholdMap& map = ThresholdMap::BlueNoise()) const;
         Image resize_nearest(const Size x, const Size y) const;
         Image resize_linear(const Size x, const Size y) const;
         Image resize_samples(const Size x, const Size y) const;
+        Image resize(const Size x, const Size y, const ResizeFilter filter = ResizeFilter::Bilinear) const;
+        Image resize(const Resampler& resampler) const;
+        Image convolve(const Kernel& kernel) const;
+        Image convolve(const Kernel& horizontal, const Kernel& vertical) const;
+        Image recursive_gaussian(const Float sigma) const;
         Image gaussian_blur(const int radius) const;
         Image box_blur(const int radius) const;
+
+    public: /* Modifications into an existing image */
+        // These write into out, reshaping it to fit, so a caller that keeps
+        // out alive between frames does not allocate. Except for to_layout,
+        // out may be *this to filter in place.
+        template<class Rounder> void dither(Rounder rounder, Image& out, const Color::RepT error_mul = 1.0) const;
+        template<class Rounder> void dither_fast(Rounder rounder, Image& out) const;
+        template<class Rounder> void dither_ordered(Rounder rounder, Image& out, const Color::RepT spread, 
+                                                    const ThresholdMap& map = ThresholdMap::BlueNoise()) const;
+        void to_layout(Layout layout, Image& out) const;
+        void resize(const Resampler& resampler, Image& out) const;
+        void convolve(const Kernel& horizontal, const Kernel& vertical, Image& out) const;
+        void recursive_gaussian(const Float sigma, Image& out) const;
+        void gaussian_blur(const int radius, Image& out) const;
+        void box_blur(const int radius, Image& out) const;
     };
 }
 
@@ -269,67 +230,152 @@ namespace SPGL
         return bytes;
     }
 
-    Image Image::dither(const std::function<Color(Color)> rounder, const Color::RepT error_mul) const 
+    /**
+     * Rounders are template parameters so they inline into the pixel loop;
+     * the palettes above can be passed directly, as can any lambda.
+     *
+     * Error diffusion walks rows in memory order and keeps the error for
+     * the rows below in a small ring of padded rows, so nothing is bounds
+     * checked and only the output image is written.
+     */
+    template<class Rounder>
+    Image Image::dither(Rounder rounder, const Color::RepT error_mul) const 
+    {
+        Image result;
+        dither(rounder, result, error_mul);
+        return result;
+    }
+
+    template<class Rounder>
+    Image Image::dither_fast(Rounder rounder) const 
+    {
+        Image result;
+        dither_fast(rounder, result);
+        return result;
+    }
+
+    template<class Rounder>
+    Image Image::dither_ordered(Rounder rounder, const Color::RepT spread, const ThresholdMap& map) const
     {
-        Image result = Image(*this);
+        Image result;
+        dither_ordered(rounder, result, spread, map);
+        return result;
+    }
+
+    template<class Rounder>
+    void Image::dither(Rounder rounder, Image& result, const Color::RepT error_mul) const 
+    {
+        result.reshape(width(), height());
 
         constexpr Color::RepT RATIO_7_48  = 7.0 / 48.0;
         constexpr Color::RepT RATIO_5_48  = 5.0 / 48.0;
         constexpr Color::RepT RATIO_3_48  = 3.0 / 48.0;
         constexpr Color::RepT RATIO_1_48  = 1.0 / 48.0;
 
-        for(long x = 0; x < width();  ++x)
-        for(long y = 0; y < height(); ++y)
+        constexpr Size ROWS = 3, PAD = 2;
+        const Size stride = width() + 2 * PAD;
+        std::vector<Color> errors(ROWS * stride);
+
+        for(Size y = 0; y < height(); ++y)
         {
-            const Color pixel = result(x, y);
-            const Color round = rounder(pixel);
-
-            result(x + 0, y + 0) = round;
-
-            const Color error = (pixel - round) * error_mul;
-            result(x + 0, y + 1) += error * RATIO_7_48;
-            result(x + 0, y + 2) += error * RATIO_5_48;
-            
-            result(x + 1, y - 2) += error * RATIO_3_48;
-            result(x + 1, y - 1) += error * RATIO_5_48;
-            result(x + 1, y + 0) += error * RATIO_7_48;
-            result(x + 1, y + 1) += error * RATIO_5_48;
-            result(x + 1, y + 2) += error * RATIO_3_48;
-            
-            result(x + 2, y - 2) += error * RATIO_1_48;
-            result(x + 2, y - 1) += error * RATIO_3_48;
-            result(x + 2, y + 0) += error * RATIO_5_48;
-            result(x + 2, y + 1) += error * RATIO_3_48;
-            result(x + 2, y + 2) += error * RATIO_1_48;
-        }
+            Color* error0 = &errors[((y + 0) % ROWS) * stride + PAD];
+            Color* error1 = &errors[((y + 1) % ROWS) * stride + PAD];
+            Color* error2 = &errors[((y + 2) % ROWS) * stride + PAD];
+
+            const Color* in = data() + y * width();
+            Color* out = result.data() + y * width();
 
-        return std::move(result);
+            for(long x = 0; x < long(width()); ++x)
+            {
+                const Color pixel = in[x] + error0[x];
+                const Color round = rounder(pixel);
+
+                out[x] = round;
+
+                const Color error = (pixel - round) * error_mul;
+                error0[x + 1] += error * RATIO_7_48;
+                error0[x + 2] += error * RATIO_5_48;
+
+                error1[x - 2] += error * RATIO_3_48;
+                error1[x - 1] += error * RATIO_5_48;
+                error1[x + 0] += error * RATIO_7_48;
+                error1[x + 1] += error * RATIO_5_48;
+                error1[x + 2] += error * RATIO_3_48;
+
+                error2[x - 2] += error * RATIO_1_48;
+                error2[x - 1] += error * RATIO_3_48;
+                error2[x + 0] += error * RATIO_5_48;
+                error2[x + 1] += error * RATIO_3_48;
+                error2[x + 2] += error * RATIO_1_48;
+            }
+
+            std::fill(error0 - PAD, error0 - PAD + stride, Color());
+        }
     }
 
-    Image Image::dither_fast(const std::function<Color(Color)> rounder) const 
+    template<class Rounder>
+    void Image::dither_fast(Rounder rounder, Image& result) const 
     {
-        Image result = Image(*this);
+        result.reshape(width(), height());
 
         constexpr Color::RepT RATIO_1_8  = 1.0 / 8.0;
 
-        for(long x = 0; x < width();  ++x)
-        for(long y = 0; y < height(); ++y)
+        constexpr Size ROWS = 3, PAD = 2;
+        const Size stride = width() + 2 * PAD;
+        std::vector<Color> errors(ROWS * stride);
+
+        for(Size y = 0; y < height(); ++y)
         {
-            const Color pixel = result(x, y);
-            const Color round = rounder(pixel);
-
-            result(x + 0, y + 0) = round;
-
-            const Color error = (pixel - round) * RATIO_1_8;
-            result(x + 0, y + 1) += error;
-            result(x + 0, y + 2) += error;
-            result(x + 1, y - 1) += error;
-            result(x + 1, y + 0) += error;
-            result(x + 1, y + 1) += error;
-            result(x + 2, y + 0) += error;
+            Color* error0 = &errors[((y + 0) % ROWS) * stride + PAD];
+            Color* error1 = &errors[((y + 1) % ROWS) * stride + PAD];
+            Color* error2 = &errors[((y + 2) % ROWS) * stride + PAD];
+
+            const Color* in = data() + y * width();
+            Color* out = result.data() + y * width();
+
+            for(long x = 0; x < long(width()); ++x)
+            {
+                const Color pixel = in[x] + error0[x];
+                const Color round = rounder(pixel);
+
+                out[x] = round;
+
+                const Color error = (pixel - round) * RATIO_1_8;
+                error0[x + 1] += error;
+                error0[x + 2] += error;
+                error1[x - 1] += error;
+                error1[x + 0] += error;
+                error1[x + 1] += error;
+                error2[x + 0] += error;
+            }
+
+            std::fill(error0 - PAD, error0 - PAD + stride, Color());
         }
+    }
+
+    // Offsets each pixel by (threshold - 0.5) * spread before rounding, which
+    // suits rounders that pick the nearest color. spread should be about the
+    // gap between palette levels, e.g. 1 / 7 for three bits. Every pixel is
+    // independent, so rows run in parallel.
+    template<class Rounder>
+    void Image::dither_ordered(Rounder rounder, Image& result, const Color::RepT spread, const ThresholdMap& map) const
+    {
+        result.reshape(width(), height());
 
-        return std::move(result);
+        Parallel::for_range(0, height(), [&](Size b, Size e) {
+            for(Size y = b; y < e; ++y)
+            {
+                const Float* thresholds = map.row(y);
+                const Color* in = data() + y * width();
+                Color* out = result.data() + y * width();
+
+                for(Size x = 0; x < width(); ++x)
+                {
+                    const Color::RepT offset = (thresholds[x & (map.size() - 1)] - 0.5) * spread;
+                    out[x] = rounder(Color(in[x].r + offset, in[x].g + offset, in[x].b + offset));
+                }
+            }
+        });
     }
 
     Image Image::resize_nearest(const Size x, const Size y) const
@@ -348,150 +394,149 @@ namespace SPGL
         return result;
     }
 
-    Image Image::resize_linear(const Size x, const Size y) const
+    void Image::reshape(const Size x, const Size y, const Layout layout)
     {
-        Image result(x, y);
-
-        for(Size ix = 0; ix < x; ++ix)
-        for(Size iy = 0; iy < y; ++iy)
-        {
-            result(ix, iy) = interpolate(Vec2d(
-                Float(ix * width()) / x, 
-                Float(iy * height()) / y
-            ));
-        }
-
-        return result;
+        _img_size = Vec2s(x, y);
+        _layout = PixelLayout(x, y, layout);
+        _img_data.resize(_layout.storage());
     }
 
-    Image Image::resize_samples(const Size x, const Size y) const
+    Image Image::to_layout(Layout layout) const
     {
-        Image result(x, y);
-
-        for(Size ix = 0; ix < x; ++ix)
-        for(Size iy = 0; iy < y; ++iy)
-        {
-            result(ix, iy) = sample_box(
-                Vec2d(
-                    Float((ix + 0.0) * width()) / x, 
-                    Float((iy + 0.0) * height()) / y
-                ),
-
-                Vec2d(
-                    Float((ix + 1.0) * width()) / x, 
-                    Float((iy + 1.0) * height()) / y
-                )
-            );
-        }
-
+        Image result;
+        to_layout(layout, result);
         return result;
     }
-}
 
-namespace SPGL
-{
-    Image Image::box_blur(const int radius) const
-    { 
-        Image out_h(width(), height());
-        Image out(width(), height());
-
-        for(int x = 0; x < width(); ++x)
-        {
-            ColorAverage pixel;
-            for(int iy = 0 - radius; iy < 0 + radius; ++iy)
-                pixel.add(get(x, iy));
+    void Image::to_layout(Layout layout, Image& result) const
+    {
+        result.reshape(width(), height(), layout);
 
-            for(int y = 0; y < height(); ++y)
+        Parallel::for_range(0, height(), [&](Size b, Size e) {
+            for(Size row = b; row < e; ++row)
+            for(Size x = 0; x < width();)
             {
-                pixel.add(get(x, y + radius));
-                out_h(x, y) = pixel.result();
-                pixel.sub(get(x, y - radius));
+                const Size run = std::min({ _layout.run(x), result._layout.run(x), width() - x });
+                const auto src = _img_data.begin() + _layout(x, row);
+                std::copy(src, src + run, result._img_data.begin() + result._layout(x, row));
+                x += run;
             }
-        }
+        });
+    }
 
-        for(int y = 0; y < height(); ++y)
-        {
-            ColorAverage pixel;
-            for(int ix = 0 - radius; ix < 0 + radius; ++ix)
-                pixel.add(out_h(ix, y));
+    Image Image::resize_linear(const Size x, const Size y) const
+    { return resize(x, y, ResizeFilter::Bilinear); }
 
-            for(int x = 0; x < width(); ++x)
-            {
-                pixel.add(out_h(x + radius, y));
-                out(x, y) = pixel.result();
-                pixel.sub(out_h(x - radius, y));
-            }
-        }
+    Image Image::resize_samples(const Size x, const Size y) const
+    { return resize(x, y, ResizeFilter::Box); }
 
-        return out;
+    Image Image::resize(const Size x, const Size y, const ResizeFilter filter) const
+    { return resize(Resampler(width(), height(), x, y, filter)); }
+
+    Image Image::resize(const Resampler& resampler) const
+    {
+        Image result;
+        resize(resampler, result);
+        return result;
     }
 
-    Image Image::gaussian_blur(const int radius) const
+    void Image::resize(const Resampler& resampler, Image& result) const
     {
-        Image result(*this);
-        const int w = std::sqrt(radius);
+        const ColorAverage space(GammaTable::STANDARD_GAMMA, resampler.positive());
 
-        for(int i = 0; i < w; ++i)
-            result = result.box_blur(w);
+        SampleBuffer& buffer = SampleBuffer::scratch(0);
+        buffer.resize(width(), height());
+        buffer.load(data(), space);
 
-        return result;
+        SampleBuffer& resized = SampleBuffer::scratch(2);
+        resampler.apply(buffer, resized);
+
+        result.reshape(resampler.dst_width(), resampler.dst_height());
+        resized.store(result.data(), space);
     }
 }
 
 namespace SPGL
 {
-    namespace PPM
+    Image Image::convolve(const Kernel& kernel) const
+    { return convolve(kernel, kernel); }
+
+    Image Image::convolve(const Kernel& horizontal, const Kernel& vertical) const
     {
-        const char* MAGIC_HEADER = "P6\n";
-        const Size COLOR_DEPTH = 255;
+        Image result;
+        convolve(horizontal, vertical, result);
+        return result;
     }
-}
 
-namespace SPGL
-{
-    std::ostream& operator<<(std::ostream& file, const Image& image)
+    Image Image::recursive_gaussian(const Float sigma) const
     {
-        file << PPM::MAGIC_HEADER;
-        file << image.width() << ' ' << image.height() << '\n';
-        file << PPM::COLOR_DEPTH << '\n';
-        
-        for(const Color& color : image)
-        { 
-            Color::Bytes raw = color.bytes();
-            file.write(reinterpret_cast<const char*>(&raw.r), 1);
-            file.write(reinterpret_cast<const char*>(&raw.g), 1);
-            file.write(reinterpret_cast<const char*>(&raw.b), 1);
-        }
-    
-        file << '\n';
+        Image result;
+        recursive_gaussian(sigma, result);
+        return result;
+    }
+
+    Image Image::box_blur(const int radius) const
+    {
+        Image result;
+        box_blur(radius, result);
+        return result;
+    }
 
-        return file;
+    Image Image::gaussian_blur(const int radius) const
+    {
+        Image result;
+        gaussian_blur(radius, result);
+        return result;
     }
-    
-    std::istream& operator>>(std::istream& file, Image& image)
+
+    void Image::convolve(const Kernel& horizontal, const Kernel& vertical, Image& result) const
     {
-        std::string type;
-        Size sx, sy;
-        std::string depth;
+        SampleBuffer& buffer = SampleBuffer::scratch(0);
+        buffer.resize(width(), height());
+        buffer.load(data());
+        Convolution::separable(buffer, horizontal, vertical);
 
-        file >> type;
-        file >> sx >> sy;
-        file >> depth;
+        result.reshape(width(), height());
+        buffer.store(result.data());
+    }
 
-        UInt8 nl;
-        file.read(reinterpret_cast<char*>(&nl), 1);
-        
-        image = Image(sx, sy);
+    void Image::recursive_gaussian(const Float sigma, Image& result) const
+    {
+        if(sigma <= 0.0) 
+        {
+            if(&result != this) to_layout(Layout::Linear, result);
+            return;
+        }
 
-        for(Size i = 0; i < sx * sy; ++i)
+        // Narrow kernels are as fast as the recursive filter, and exact
+        if(sigma < 8.0) 
         {
-            UInt8 r, g, b;
-            file.read(reinterpret_cast<char*>(&r), 1);
-            file.read(reinterpret_cast<char*>(&g), 1);
-            file.read(reinterpret_cast<char*>(&b), 1);
-            image[i] = Color::Bytes(r, g, b);
+            const Kernel kernel = Kernel::Gaussian(sigma);
+            convolve(kernel, kernel, result);
+            return;
         }
 
-        return file;
+        SampleBuffer& buffer = SampleBuffer::scratch(0);
+        buffer.resize(width(), height());
+        buffer.load(data());
+        Convolution::recursive_gaussian(buffer, sigma);
+
+        result.reshape(width(), height());
+        buffer.store(result.data());
+    }
+
+    void Image::box_blur(const int radius, Image& result) const
+    {
+        const Kernel kernel = Kernel::Box(radius);
+        convolve(kernel, kernel, result);
+    }
+
+    void Image::gaussian_blur(const int radius, Image& result) const
+    {
+        // Same spread as w box blurs of radius w, w = sqrt(radius)
+        const int w = std::sqrt(radius);
+        recursive_gaussian(std::sqrt(w * w * (w + 1) / 3.0), result);
     }
-}
\ No newline at end of file
+}
+
+#include "formats/PPM.hpp"
@@ -0,0 +1,155 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include <string> // std::string
+#include <memory> // std::shared_ptr, std::unique_ptr
+#include <atomic> // std::atomic
+#include <mutex> // std::mutex
+#include <unordered_map> // std::unordered_map
+
+#include "math/Vector2D.hpp"
+#include "TypeNames.hpp"
+#include "MappedFile.hpp"
+#include "Sampling.hpp"
+#include "Image.hpp"
+#include "formats/PNG.hpp"
+
+namespace SPGL
+{
+    /**
+     * Read only image backed by a memory mapped file. Binary PPM rows are
+     * converted to colors the first time they are read, so only the parts
+     * of a large sky map that are ever sampled take up memory. PNGs are
+     * inflated when opened but kept at their own bit depth, and pixels are
+     * converted as they are read. P3 files are decoded whole.
+     *
+     * Reads are safe from any number of threads. Use open() to share one
+     * copy between every engine that loads the same file.
+     */
+    class LazyImage
+    {
+    public:
+        using value_type = Color;
+
+    private:
+        MappedFile _file;
+        PPM::Header _header;
+        PNG::Raster _raster;
+        Image _decoded; // Everything, when rows can't be decoded alone
+
+        std::unique_ptr<std::unique_ptr<Color[]>[]> _rows;
+        std::unique_ptr<std::atomic<const Color*>[]> _ready;
+        mutable std::mutex _decode;
+
+        inline static const Color _garbage{};
+
+    public:
+        explicit LazyImage(const std::string& file_name)
+            : _file{file_name}, _header{}, _raster{}, _decoded{}
+        {
+            if(!_file.good()) return;
+
+            if(PPM::parse_header(_file.data(), _file.size(), _header)
+            && _header.encoding == PPM::Encoding::Binary
+            && _file.size() >= _header.offset + _header.stride() * _header.height)
+            {
+                _rows = std::make_unique<std::unique_ptr<Color[]>[]>(_header.height);
+                _ready = std::make_unique<std::atomic<const Color*>[]>(_header.height);
+                return;
+            }
+
+            _header = PPM::Header{};
+            if(PNG::read(_file.data(), _file.size(), _raster))
+            {
+                _header.width = _raster.width;
+                _header.height = _raster.height;
+                _rows = std::make_unique<std::unique_ptr<Color[]>[]>(_header.height);
+                _ready = std::make_unique<std::atomic<const Color*>[]>(_header.height);
+            }
+            else if(PPM::decode(_file.data(), _file.size(), _decoded))
+            {
+                _header.width = _decoded.width();
+                _header.height = _decoded.height();
+            }
+            _file = MappedFile{};
+        }
+
+        LazyImage(const LazyImage&) = delete;
+        LazyImage& operator=(const LazyImage&) = delete;
+
+        // Images already open are shared until every user lets go of them
+        static std::shared_ptr<const LazyImage> open(const std::string& file_name)
+        {
+            static std::mutex lock;
+            static std::unordered_map<std::string, std::weak_ptr<const LazyImage>> cache;
+
+            const std::lock_guard<std::mutex> guard(lock);
+
+            std::shared_ptr<const LazyImage> image = cache[file_name].lock();
+            if(!image)
+            {
+                image = std::make_shared<const LazyImage>(file_name);
+                cache[file_name] = image;
+            }
+
+            return image;
+        }
+
+    public:
+        Size width() const { return _header.width; }
+        Size height() const { return _header.height; }
+
+        // Pixels of a row, with row 0 at the top
+        const Color* row(const Size r) const
+        {
+            if(!_ready) return _decoded.data() + r * width();
+
+            const Color* pixels = _ready[r].load(std::memory_order_acquire);
+            if(pixels) return pixels;
+
+            const std::lock_guard<std::mutex> guard(_decode);
+            pixels = _ready[r].load(std::memory_order_relaxed);
+            if(!pixels)
+            {
+                _rows[r] = std::make_unique<Color[]>(width());
+                if(!_raster.empty()) _raster.decode_row(r, _rows[r].get());
+                else PPM::decode_rows(_header, _file.data() + _header.offset, r, r + 1, _rows[r].get());
+                pixels = _rows[r].get();
+                _ready[r].store(pixels, std::memory_order_release);
+            }
+
+            return pixels;
+        }
+
+        // PNG pixels are converted on every read, so none are kept
+        value_type get(Size x, Size y) const
+        {
+            if(width()  <= x) { return _garbage; }
+            if(height() <= y) { return _garbage; }
+            if(!_raster.empty()) return _raster.pixel(x, height() - 1 - y);
+            return row(height() - 1 - y)[x];
+        }
+
+        value_type get(Vec2s i) const { return get(i.x, i.y); }
+        value_type operator()(Size x, Size y) const { return get(x, y); }
+
+        value_type interpolate(Vec2d i) const
+        { return Sampling::interpolate(*this, i); }
+
+        value_type sample_box(Vec2d beg, Vec2d end) const
+        { return Sampling::sample_box(*this, beg, end); }
+    };
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include <string> // std::string
+#include <utility> // std::exchange
+
+#include <fcntl.h> // open
+#include <sys/mman.h> // mmap, munmap
+#include <sys/stat.h> // fstat
+#include <unistd.h> // close
+
+#include "TypeNames.hpp"
+
+namespace SPGL
+{
+    // Read only view of a whole file. Pages are only read in once touched.
+    class MappedFile
+    {
+    private:
+        const UInt8* _data;
+        Size _size;
+
+    public:
+        MappedFile() : _data{nullptr}, _size{0} {}
+
+        explicit MappedFile(const std::string& file_name) : MappedFile()
+        {
+            const int fd = ::open(file_name.c_str(), O_RDONLY);
+            if(fd < 0) return;
+
+            struct stat info;
+            if(::fstat(fd, &info) == 0 && info.st_size > 0)
+            {
+                void* map = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if(map != MAP_FAILED)
+                {
+                    _data = static_cast<const UInt8*>(map);
+                    _size = info.st_size;
+                }
+            }
+
+            ::close(fd);
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        MappedFile(MappedFile&& other)
+            : _data{std::exchange(other._data, nullptr)}
+            , _size{std::exchange(other._size, 0)} {}
+
+        MappedFile& operator=(MappedFile&& other)
+        {
+            std::swap(_data, other._data);
+            std::swap(_size, other._size);
+            return *this;
+        }
+
+        ~MappedFile()
+        { if(_data) ::munmap(const_cast<UInt8*>(_data), _size); }
+
+    public:
+        bool good() const { return _data != nullptr; }
+
+        const UInt8* data() const { return _data; }
+        Size size() const { return _size; }
+    };
+}
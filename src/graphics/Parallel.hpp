@@ -0,0 +1,138 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include <algorithm> // std::min, std::max
+#include <thread> // std::thread
+#include <vector> // std::vector
+#include <atomic> // std::atomic
+#include <mutex> // std::mutex
+#include <condition_variable> // std::condition_variable
+#include <exception> // std::exception_ptr
+
+#include "TypeNames.hpp"
+
+namespace SPGL
+{
+    namespace Parallel
+    {
+        // Below this many items per thread, splitting is not worth a thread
+        constexpr Size MIN_GRAIN = 16;
+
+        Size threads()
+        {
+            static const Size count = std::max<Size>(1, std::thread::hardware_concurrency());
+            return count;
+        }
+
+        // Set on the workers of ordered(), which already keep every core busy
+        bool& nested()
+        {
+            static thread_local bool flag = false;
+            return flag;
+        }
+
+        // Splits [begin, end) into one contiguous chunk per thread and calls
+        // func(chunk_begin, chunk_end) on each. Returns once all are done.
+        // Inside a worker of ordered() it runs everything on the caller.
+        template<class Func>
+        void for_range(const Size begin, const Size end, Func&& func, const Size grain = MIN_GRAIN)
+        {
+            if(end <= begin) return;
+
+            const Size items = end - begin;
+            const Size chunks = nested() ? 1 : std::min(threads(), std::max<Size>(1, items / std::max<Size>(1, grain)));
+
+            if(chunks <= 1) { func(begin, end); return; }
+
+            std::vector<std::thread> workers;
+            workers.reserve(chunks - 1);
+
+            const Size step = (items + chunks - 1) / chunks;
+            for(Size i = begin + step; i < end; i += step)
+                workers.emplace_back([&func, i, step, end] { func(i, std::min(i + step, end)); });
+
+            func(begin, std::min(begin + step, end));
+
+            for(std::thread& worker : workers) worker.join();
+        }
+
+        /**
+         * Calls work(worker, i) for every i in [0, count) on up to workers
+         * threads, each taking the next i when it is free, then calls
+         * emit(worker, i) strictly in order of i. A worker waits for its
+         * turn to emit before taking more work, so at most workers results
+         * are ever waiting. worker is in [0, workers), for per thread state.
+         * After the first exception no more work is started, and it is
+         * rethrown once the work already started has finished.
+         */
+        template<class Work, class Emit>
+        void ordered(const Size count, Size workers, Work&& work, Emit&& emit)
+        {
+            workers = std::max<Size>(1, std::min(workers, count));
+
+            std::atomic<Size> next_work{0};
+            std::mutex lock;
+            std::condition_variable turn;
+            Size next_emit = 0;
+            std::exception_ptr error;
+            std::atomic<bool> failed{false};
+
+            // With one worker, for_range is still free to use every core
+            const bool outer = nested();
+            const auto run = [&](Size worker) {
+                nested() = outer || workers > 1;
+
+                for(Size i; !failed && (i = next_work++) < count;)
+                {
+                    try { if(!failed) work(worker, i); }
+                    catch(...) { const std::lock_guard<std::mutex> guard(lock); if(!error) error = std::current_exception(); failed = true; }
+
+                    std::unique_lock<std::mutex> guard(lock);
+                    turn.wait(guard, [&] { return next_emit == i; });
+
+                    if(!error)
+                    {
+                        guard.unlock();
+                        try { emit(worker, i); }
+                        catch(...) { guard.lock(); if(!error) error = std::current_exception(); failed = true; guard.unlock(); }
+                        guard.lock();
+                    }
+
+                    ++next_emit;
+                    turn.notify_all();
+                }
+            };
+
+            std::vector<std::thread> threads;
+            threads.reserve(workers - 1);
+            for(Size w = 1; w < workers; ++w) threads.emplace_back(run, w);
+            run(0);
+            nested() = outer;
+            for(std::thread& thread : threads) thread.join();
+
+            if(error) std::rethrow_exception(error);
+        }
+
+        // Calls func(i) for every i in [begin, end), split across threads
+        template<class Func>
+        void for_each(const Size begin, const Size end, Func&& func, const Size grain = MIN_GRAIN)
+        {
+            for_range(begin, end, [&func](Size b, Size e) {
+                for(Size i = b; i < e; ++i) func(i);
+            }, grain);
+        }
+    }
+}
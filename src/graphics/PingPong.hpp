@@ -0,0 +1,51 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include "TypeNames.hpp"
+#include "Image.hpp"
+
+namespace SPGL
+{
+    // Two images that the passes of a post processing chain alternate
+    // between. Keeping them alive lets every frame reuse their storage.
+    class PingPong
+    {
+    private:
+        Image _buffers[2];
+        Size _front;
+
+    public:
+        PingPong() : _buffers{}, _front{0} {}
+
+    public:
+        Image& front() { return _buffers[_front]; }
+        const Image& front() const { return _buffers[_front]; }
+
+        Image& back() { return _buffers[_front ^ 1]; }
+        const Image& back() const { return _buffers[_front ^ 1]; }
+
+        void swap() { _front ^= 1; }
+
+        // Runs pass(front(), back()), then makes back() the new front()
+        template<class Pass>
+        Image& apply(Pass&& pass)
+        {
+            pass(static_cast<const Image&>(front()), back());
+            swap();
+            return front();
+        }
+    };
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include <algorithm> // std::min
+#include <bit> // std::bit_width
+#include <optional> // std::optional
+#include <string_view> // std::string_view
+
+#include "TypeNames.hpp"
+
+namespace SPGL
+{
+    enum class Layout
+    {
+        Linear, // Rows one after another, top row first
+        Tiled,  // 8x8 tiles in row order, each tile stored row by row
+        Morton  // Z order curve over the whole image
+    };
+
+    inline std::optional<Layout> layout(const std::string_view name)
+    {
+        if(name == "linear") return Layout::Linear;
+        if(name == "tiled") return Layout::Tiled;
+        if(name == "morton") return Layout::Morton;
+        return std::nullopt;
+    }
+
+    /**
+     * Maps a pixel (x, row), with row 0 at the top, to its offset in storage.
+     *
+     * Triangles touch a small region of the screen, which in a linear image
+     * is one cache line per row. Tiled and Morton layouts keep such regions
+     * together in memory while rasterizing; the buffer is converted back to
+     * Linear once the frame is done.
+     */
+    class PixelLayout
+    {
+    public:
+        constexpr static Size TILE_BITS = 3;
+        constexpr static Size TILE = Size(1) << TILE_BITS;
+
+    private:
+        Layout _layout;
+        Size _width, _height;
+
+        Size _tiles_x;   // Tiled: tiles per row
+        Size _common;    // Morton: bits interleaved from both axes
+
+    public:
+        PixelLayout(const Size width = 0, const Size height = 0, const Layout layout = Layout::Linear)
+            : _layout{layout}
+            , _width{width}, _height{height}
+            , _tiles_x{(width + TILE - 1) / TILE}
+            , _common{Size(std::min(std::bit_width(width - (width > 0)), std::bit_width(height - (height > 0))))} {}
+
+    public:
+        Layout layout() const { return _layout; }
+
+        // Number of elements needed to store the image, including padding
+        Size storage() const
+        {
+            switch(_layout)
+            {
+                case Layout::Tiled:
+                    return _tiles_x * TILE * ((_height + TILE - 1) / TILE) * TILE;
+
+                case Layout::Morton:
+                    return std::bit_ceil(_width) * std::bit_ceil(_height);
+
+                default:
+                    return _width * _height;
+            }
+        }
+
+        Size operator()(const Size x, const Size row) const
+        {
+            switch(_layout)
+            {
+                case Layout::Tiled:
+                {
+                    const Size tile = (row >> TILE_BITS) * _tiles_x + (x >> TILE_BITS);
+                    return (tile << (2 * TILE_BITS)) + ((row & (TILE - 1)) << TILE_BITS) + (x & (TILE - 1));
+                }
+
+                case Layout::Morton:
+                {
+                    // Only the larger axis has bits past _common, so they
+                    // can be stacked above the interleaved ones
+                    const Size low = (Size(1) << _common) - 1;
+                    return spread(x & low) | (spread(row & low) << 1)
+                         | (((x >> _common) | (row >> _common)) << (2 * _common));
+                }
+
+                default:
+                    return row * _width + x;
+            }
+        }
+
+        // How many pixels starting at (x, row) are next to each other in storage
+        Size run(const Size x) const
+        {
+            switch(_layout)
+            {
+                case Layout::Tiled: return TILE - (x & (TILE - 1));
+                case Layout::Morton: return 2 - (x & 1);
+                default: return _width - x;
+            }
+        }
+
+    private:
+        // Moves bit i of a 32 bit value to bit 2i
+        static UInt64 spread(UInt64 v)
+        {
+            v = (v | (v << 16)) & 0x0000ffff0000ffffull;
+            v = (v | (v <<  8)) & 0x00ff00ff00ff00ffull;
+            v = (v | (v <<  4)) & 0x0f0f0f0f0f0f0f0full;
+            v = (v | (v <<  2)) & 0x3333333333333333ull;
+            v = (v | (v <<  1)) & 0x5555555555555555ull;
+            return v;
+        }
+    };
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include <vector> // std::vector
+#include <cmath> // std::floor, std::sin
+
+#include "math/MathConstants.hpp"
+#include "TypeNames.hpp"
+#include "Convolution.hpp"
+#include "Parallel.hpp"
+
+namespace SPGL
+{
+    enum class ResizeFilter
+    {
+        Box,      // Exact area average, same as sample_box
+        Bilinear, // Triangle, radius 1
+        Bicubic,  // Catmull-Rom, radius 2
+        Lanczos   // Lanczos 3, radius 3
+    };
+
+    /**
+     * Resizes SampleBuffers from one fixed size to another. The filter taps
+     * for every output column and row are computed once on construction, so
+     * one Resampler can be reused for every frame of the same size.
+     *
+     * When shrinking, the filter is stretched to cover the source pixels
+     * each output pixel spans, so it also acts as the antialiasing filter.
+     */
+    class Resampler
+    {
+    private:
+        // Taps for one axis: output i reads count source pixels starting at
+        // begin[i], with weights taps[i * stride, i * stride + count)
+        struct Weights
+        {
+            Size stride;
+            std::vector<Size> begin, count;
+            std::vector<Float> taps;
+
+            Weights() : stride{0} {}
+
+            Weights(const Size src, const Size dst, const ResizeFilter filter)
+                : stride{0}, begin(dst), count(dst)
+            {
+                const Float ratio = Float(src) / Float(dst);
+                const Float scale = std::max(ratio, 1.0);
+                const Float support = (filter == ResizeFilter::Box ? 0.5 * ratio : radius(filter) * scale);
+
+                stride = Size(std::ceil(2.0 * support)) + 2;
+                taps.assign(dst * stride, 0.0);
+
+                for(Size i = 0; i < dst; ++i)
+                {
+                    const Float center = (i + 0.5) * ratio;
+                    const long lo = std::max(0l, long(std::floor(center - support)));
+                    const long hi = std::min(long(src), long(std::ceil(center + support)));
+
+                    begin[i] = lo;
+                    count[i] = std::max(0l, hi - lo);
+
+                    Float total = 0.0;
+                    Float* weights = &taps[i * stride];
+                    for(long j = lo; j < hi; ++j)
+                    {
+                        const Float weight = (filter == ResizeFilter::Box)
+                            ? overlap(center - support, center + support, j, j + 1.0)
+                            : evaluate(filter, (j + 0.5 - center) / scale);
+
+                        weights[j - lo] = weight;
+                        total += weight;
+                    }
+
+                    if(total != 0.0)
+                        for(Size k = 0; k < count[i]; ++k) weights[k] /= total;
+                }
+            }
+        };
+
+    private:
+        Size _src_width, _src_height;
+        Size _dst_width, _dst_height;
+        ResizeFilter _filter;
+        Weights _horizontal, _vertical;
+
+    public:
+        Resampler(const Size src_width, const Size src_height,
+                  const Size dst_width, const Size dst_height,
+                  const ResizeFilter filter = ResizeFilter::Bilinear)
+            : _src_width{src_width}, _src_height{src_height}
+            , _dst_width{dst_width}, _dst_height{dst_height}
+            , _filter{filter}
+            , _horizontal(src_width, dst_width, filter)
+            , _vertical(src_height, dst_height, filter) {}
+
+    public:
+        Size src_width()  const { return _src_width; }
+        Size src_height() const { return _src_height; }
+        Size dst_width()  const { return _dst_width; }
+        Size dst_height() const { return _dst_height; }
+        ResizeFilter filter() const { return _filter; }
+
+        // Filters with negative lobes can drive the luma weight of a sample
+        // to zero, so they should be run on unweighted samples
+        bool positive() const
+        { return _filter == ResizeFilter::Box || _filter == ResizeFilter::Bilinear; }
+
+        void apply(const SampleBuffer& in, SampleBuffer& out) const
+        {
+            constexpr Size CHANNELS = SampleBuffer::CHANNELS;
+
+            SampleBuffer& temp = SampleBuffer::scratch(1);
+            temp.resize(_dst_width, _src_height);
+            out.resize(_dst_width, _dst_height);
+
+            // Horizontal, one row of the source at a time
+            Parallel::for_range(0, _src_height, [&](Size b, Size e) {
+                for(Size y = b; y < e; ++y)
+                {
+                    const Float* src = in.row(y);
+                    Float* dst = temp.row(y);
+
+                    for(Size x = 0; x < _dst_width; ++x)
+                    {
+                        const Float* weights = &_horizontal.taps[x * _horizontal.stride];
+                        const Float* pixel = src + CHANNELS * _horizontal.begin[x];
+
+                        Float sum[CHANNELS] = {};
+                        for(Size k = 0; k < _horizontal.count[x]; ++k)
+                            for(Size c = 0; c < CHANNELS; ++c)
+                                sum[c] += weights[k] * pixel[CHANNELS * k + c];
+
+                        for(Size c = 0; c < CHANNELS; ++c)
+                            dst[CHANNELS * x + c] = sum[c];
+                    }
+                }
+            });
+
+            // Vertical, as weighted sums of whole rows
+            Parallel::for_range(0, _dst_height, [&](Size b, Size e) {
+                const Size n = CHANNELS * _dst_width;
+                for(Size y = b; y < e; ++y)
+                {
+                    Float* dst = out.row(y);
+                    std::fill(dst, dst + n, 0.0);
+
+                    const Float* weights = &_vertical.taps[y * _vertical.stride];
+                    for(Size k = 0; k < _vertical.count[y]; ++k)
+                        Convolution::axpy(dst, temp.row(_vertical.begin[y] + k), weights[k], n);
+                }
+            });
+        }
+
+    private:
+        static Float radius(const ResizeFilter filter)
+        {
+            switch(filter)
+            {
+                case ResizeFilter::Box: return 0.5;
+                case ResizeFilter::Bilinear: return 1.0;
+                case ResizeFilter::Bicubic: return 2.0;
+                default: return 3.0;
+            }
+        }
+
+        static Float sinc(const Float x)
+        {
+            if(std::abs(x) < 1e-8) return 1.0;
+            const Float pi_x = Float(Math::PI) * x;
+            return std::sin(pi_x) / pi_x;
+        }
+
+        static Float evaluate(const ResizeFilter filter, Float x)
+        {
+            x = std::abs(x);
+
+            switch(filter)
+            {
+                case ResizeFilter::Box:
+                    return x < 0.5 ? 1.0 : 0.0;
+
+                case ResizeFilter::Bilinear:
+                    return x < 1.0 ? 1.0 - x : 0.0;
+
+                case ResizeFilter::Bicubic:
+                    if(x < 1.0) return (1.5 * x - 2.5) * x * x + 1.0;
+                    if(x < 2.0) return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+                    return 0.0;
+
+                default:
+                    return x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+            }
+        }
+
+        static Float overlap(const Float a0, const Float a1, const Float b0, const Float b1)
+        { return std::max(0.0, std::min(a1, b1) - std::max(a0, b0)); }
+    };
+}
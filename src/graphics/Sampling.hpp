@@ -0,0 +1,89 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include <cmath> // std::floor
+#include <utility> // std::swap
+
+#include "math/Math.hpp"
+#include "math/Vector2D.hpp"
+#include "TypeNames.hpp"
+#include "Color.hpp"
+
+namespace SPGL
+{
+    // Filtered reads shared by anything with get(x, y) returning a Color,
+    // where out of bounds reads give black
+    namespace Sampling
+    {
+        template<class Source>
+        Color interpolate(const Source& image, Vec2d i)
+        {
+            Float x_f = Math::fpart(i.x);
+            Float y_f = Math::fpart(i.y);
+            
+            Float x_rf = 1.0 - x_f;
+            Float y_rf = 1.0 - y_f;
+
+            Vec2i pos(std::floor(i.x), std::floor(i.y));
+
+            return (
+                x_rf * y_rf * image.get(pos + Vec2i(0, 0)) +
+                x_f  * y_rf * image.get(pos + Vec2i(1, 0)) +
+                x_rf * y_f  * image.get(pos + Vec2i(0, 1)) +
+                x_f  * y_f  * image.get(pos + Vec2i(1, 1)) 
+            );
+        } 
+
+        template<class Source>
+        Color sample_box(const Source& image, Vec2d beg, Vec2d end, ColorAverage color = {})
+        {
+            if(end.x < beg.x) std::swap(beg.x, end.x);
+            if(end.y < beg.y) std::swap(beg.y, end.y);
+         
+            const Size fy_beg = std::floor(beg.y);
+            const Size fy_end = std::floor(end.y);
+            const Size fx_beg = std::floor(beg.x);
+            const Size fx_end = std::floor(end.x);
+
+            const Float px_beg = 1 + fx_beg - beg.x;
+            const Float py_beg = 1 + fy_beg - beg.y;
+            
+            const Float px_end = end.x - fx_end;
+            const Float py_end = end.y - fy_end;
+
+            color.add(image.get(fx_beg, fy_beg), px_beg * py_beg);
+            color.add(image.get(fx_end, fy_beg), px_end * py_beg);
+            color.add(image.get(fx_beg, fy_end), px_beg * py_end);
+            color.add(image.get(fx_end, fy_end), px_end * py_end);
+
+            for(Size x = fx_beg + 1; x < fx_end; ++x) 
+            {
+                color.add(image.get(x, fy_beg), py_beg);
+                color.add(image.get(x, fy_end), py_end);
+            }
+
+            for(Size y = fy_beg + 1; y < fy_end; ++y) 
+            {
+                color.add(image.get(fx_beg, y), px_beg);
+                color.add(image.get(fx_end, y), px_end);
+                for(Size x = fx_beg + 1; x < fx_end; ++x) 
+                    color.add(image.get(x, y));
+            }
+
+            return color.result();
+        }
+    }
+}
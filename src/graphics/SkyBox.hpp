@@ -14,30 +14,25 @@
  * copies or substantial portions of the Software.
  */
 
-#include "Image.hpp"
+#include "LazyImage.hpp"
 #include "math/Math.hpp"
 #include "math/Vector3D.hpp"
 #include <string>
 #include <cmath>
-#include <fstream>
+#include <memory>
 
 namespace SPGL
 {
     class SkyBox
     {
     private:
-        Image _image;
+        // Shared by every SkyBox using the same file
+        std::shared_ptr<const LazyImage> _image;
 
     public:
-        SkyBox() : _image{1, 1, Color::Black} {}
+        SkyBox() : _image{} {}
 
-        SkyBox(std::string file)
-        {
-            std::fstream skybox;
-            skybox.open(file.c_str(), std::fstream::in);
-            skybox >> _image;
-            skybox.close();
-        }
+        SkyBox(std::string file) : _image{LazyImage::open(file)} {}
 
         SkyBox(const SkyBox& other) = default;
         SkyBox& operator=(const SkyBox& other) = default;
@@ -47,22 +42,24 @@ namespace SPGL
     private:
         Vec2d get_pixel(Vec3d dir) const
         {
+            const LazyImage& image = *_image;
             dir = dir.normalized();
 
             Float x_ang = std::atan2(dir.z, dir.x);
             return Vec2d(
-                Math::map(x_ang,    -Math::PI,  Math::PI,   0.0, _image.width() - 1.0), 
-                Math::map(dir.y,    -1.0,       1.0,        0.0, _image.height() - 1.0)
+                Math::map(x_ang,    -Math::PI,  Math::PI,   0.0, image.width() - 1.0), 
+                Math::map(dir.y,    -1.0,       1.0,        0.0, image.height() - 1.0)
             );
         }
 
     public:
         Color operator()(Vec3d dir) const
-        { return _image.interpolate(get_pixel(dir)); }
+        { return _image ? _image->interpolate(get_pixel(dir)) : Color::Black; }
 
         Color diffuse(Vec3d dir, Float dev = 0.25) const
         {
-            return _image.sample_box(
+            if(!_image) return Color::Black;
+            return _image->sample_box(
                 get_pixel(dir + Vec3d(dev, dev, dev)),
                 get_pixel(dir - Vec3d(dev, dev, dev))
             );
@@ -0,0 +1,178 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include <vector> // std::vector
+#include <random> // std::mt19937
+#include <algorithm> // std::min
+#include <cmath> // std::exp
+
+#include "TypeNames.hpp"
+
+namespace SPGL
+{
+    /**
+     * Square, power of two sized table of thresholds in (0, 1) that tiles
+     * the plane. Each threshold is used exactly once per tile, so ordered
+     * dithering against it has no dependency between pixels.
+     */
+    class ThresholdMap
+    {
+    private:
+        Size _size;
+        std::vector<Float> _values;
+
+        // Turns a permutation of [0, size^2) into evenly spaced thresholds
+        ThresholdMap(const Size size, const std::vector<Size>& ranks)
+            : _size{size}
+            , _values(ranks.size())
+        {
+            for(Size i = 0; i < ranks.size(); ++i)
+                _values[i] = (ranks[i] + 0.5) / Float(ranks.size());
+        }
+
+    public:
+        Size size() const { return _size; }
+
+        Float operator()(const Size x, const Size y) const
+        { return _values[(y & (_size - 1)) * _size + (x & (_size - 1))]; }
+
+        // The thresholds for one row of the tile, size() long
+        const Float* row(const Size y) const
+        { return &_values[(y & (_size - 1)) * _size]; }
+
+    public:
+        // Classic recursive Bayer matrix, 2^order pixels across
+        static ThresholdMap Bayer(const Size order)
+        {
+            std::vector<Size> ranks{0};
+
+            for(Size size = 1; size < (Size(1) << order); size *= 2)
+            {
+                std::vector<Size> next(4 * size * size);
+
+                for(Size y = 0; y < size; ++y)
+                for(Size x = 0; x < size; ++x)
+                {
+                    const Size rank = 4 * ranks[y * size + x];
+                    next[(y + 0   ) * 2 * size + (x + 0   )] = rank + 0;
+                    next[(y + 0   ) * 2 * size + (x + size)] = rank + 2;
+                    next[(y + size) * 2 * size + (x + 0   )] = rank + 3;
+                    next[(y + size) * 2 * size + (x + size)] = rank + 1;
+                }
+
+                ranks = std::move(next);
+            }
+
+            return ThresholdMap(Size(1) << order, ranks);
+        }
+
+        // 64x64 blue noise made with Ulichney's void and cluster method
+        // the first time it is asked for
+        static const ThresholdMap& BlueNoise()
+        {
+            static const ThresholdMap map = void_and_cluster(64, 1.5);
+            return map;
+        }
+
+    private:
+        static ThresholdMap void_and_cluster(const Size size, const Float sigma)
+        {
+            const Size area = size * size;
+            const Size mask = size - 1;
+
+            // Toroidal gaussian, indexed by the wrapped offset between pixels
+            std::vector<Float> kernel(area);
+            for(Size dy = 0; dy < size; ++dy)
+            for(Size dx = 0; dx < size; ++dx)
+            {
+                const Float x = std::min(dx, size - dx);
+                const Float y = std::min(dy, size - dy);
+                kernel[dy * size + dx] = std::exp(-(x * x + y * y) / (2.0 * sigma * sigma));
+            }
+
+            std::vector<bool> bits(area, false);
+            std::vector<Float> energy(area, 0.0);
+
+            const auto toggle = [&](const Size p) {
+                const Float sign = bits[p] ? -1.0 : 1.0;
+                bits[p] = !bits[p];
+
+                const Size px = p & mask, py = p / size;
+                for(Size y = 0; y < size; ++y)
+                for(Size x = 0; x < size; ++x)
+                    energy[y * size + x] += sign * kernel[((y - py) & mask) * size + ((x - px) & mask)];
+            };
+
+            // Tightest cluster is the set pixel with the most energy,
+            // largest void is the empty pixel with the least
+            const auto find = [&](const bool set) {
+                Size best = area;
+                for(Size p = 0; p < area; ++p)
+                {
+                    if(bits[p] != set) continue;
+                    if(best == area || (set ? energy[p] > energy[best] : energy[p] < energy[best]))
+                        best = p;
+                }
+                return best;
+            };
+
+            // Random initial pattern, relaxed until moving the tightest
+            // cluster leaves it where it was
+            std::mt19937 rng(area);
+            const Size initial = area / 10;
+            for(Size count = 0; count < initial;)
+            {
+                const Size p = rng() % area;
+                if(!bits[p]) { toggle(p); ++count; }
+            }
+
+            for(Size i = 0; i < area; ++i)
+            {
+                const Size cluster = find(true);
+                toggle(cluster);
+
+                const Size void_ = find(false);
+                toggle(void_);
+
+                if(void_ == cluster) break;
+            }
+
+            std::vector<Size> ranks(area);
+            const std::vector<bool> prototype_bits = bits;
+            const std::vector<Float> prototype_energy = energy;
+
+            // Remove clusters from the prototype, ranking down from initial
+            for(Size rank = initial; rank-- > 0;)
+            {
+                const Size cluster = find(true);
+                toggle(cluster);
+                ranks[cluster] = rank;
+            }
+
+            // Fill voids from the prototype, ranking up to the full area
+            bits = prototype_bits;
+            energy = prototype_energy;
+            for(Size rank = initial; rank < area; ++rank)
+            {
+                const Size void_ = find(false);
+                toggle(void_);
+                ranks[void_] = rank;
+            }
+
+            return ThresholdMap(size, ranks);
+        }
+    };
+}
@@ -20,6 +20,7 @@
 #include <iterator> // std::reverse_iterator
 
 #include "TypeNames.hpp"
+#include "PixelLayout.hpp"
 #include "Vertex.hpp"
 #include "Color.hpp"
 
@@ -54,9 +55,12 @@ namespace SPGL // Definitions
         bool empty()  const { return (_img_size.x | _img_size.y) == 0; }
         Size size()   const { return _img_size.x * _img_size.y; }
 
+        // Raw storage; only laid out row by row when layout() is Linear
         const value_type* data() const { return _img_data.data(); }
         value_type* data() { return _img_data.data(); }
 
+        Layout layout() const { return _layout.layout(); }
+
     public: /* Constructors */
         // Default Constructor
         ZBuffer() {}
@@ -68,9 +72,10 @@ namespace SPGL // Definitions
         ZBuffer& operator=(ZBuffer&& in) = default;
 
         // Create Functions
-        ZBuffer(Size x, Size y)
+        ZBuffer(Size x, Size y, Layout layout = Layout::Linear)
             : _img_size{x, y}
-            , _img_data{std::vector<value_type>(x * y, initial_value)}
+            , _layout{x, y, layout}
+            , _img_data{std::vector<value_type>(_layout.storage(), initial_value)}
             , _garbage{} {}
 
     public: /* Accessors */
@@ -88,14 +93,14 @@ namespace SPGL // Definitions
         {
             if(width()  <= x) { return _garbage; }
             if(height() <= y) { return _garbage; }
-            return _img_data[(height() - 1 - y) * width() + x];
+            return _img_data[_layout(x, height() - 1 - y)];
         }
 
         const value_type& get(Size x, Size y) const 
         {
             if(width()  <= x) { return _garbage; }
             if(height() <= y) { return _garbage; }
-            return _img_data[(height() - 1 - y) * width() + x];
+            return _img_data[_layout(x, height() - 1 - y)];
         }
         
         /***/ value_type& get(Vec2s i)     /***/ { return get(i.x, i.y); }
@@ -117,8 +122,9 @@ namespace SPGL // Definitions
         }
 
     private: /* Raw Data */
-        std::vector<value_type> _img_data;
         Vec2s _img_size;
+        PixelLayout _layout;
+        std::vector<value_type> _img_data;
         value_type _garbage;
 
     public: /* Iterators */
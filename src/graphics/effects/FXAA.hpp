@@ -18,6 +18,7 @@
 
 #include "../math/Math.hpp"
 #include "../math/Vector2D.hpp"
+#include "../Parallel.hpp"
 #include "../Image.hpp"
 
 namespace SPGL
@@ -147,18 +148,27 @@ namespace SPGL
             return image.interpolate(final_pos);
         }
 
-        Image apply(const Image& image)
+        // result must not be image, since neighbours are read after the
+        // pixels around them have been written
+        void apply(const Image& image, Image& result)
         {
-            Image result(image);
-
-            for(int x = 0; x < image.width(); ++x)
-            for(int y = 0; y < image.height(); ++y)
-            {
-                Vec2i pos(x, y);
-                result(pos) = get_pixel(image, pos);
-            }
+            result.reshape(image.width(), image.height());
+
+            Parallel::for_range(0, image.height(), [&](Size b, Size e) {
+                for(Size y = b; y < e; ++y)
+                for(Size x = 0; x < image.width(); ++x)
+                {
+                    const Vec2i pos{int(x), int(y)};
+                    result(pos) = get_pixel(image, pos);
+                }
+            });
+        }
 
+        Image apply(const Image& image)
+        {
+            Image result;
+            apply(image, result);
             return result;
         }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,513 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include <vector> // std::vector
+#include <algorithm> // std::sort
+#include <array> // std::array
+#include <bit> // std::bit_width
+
+#include "../TypeNames.hpp"
+
+namespace SPGL
+{
+    /**
+     * Self contained zlib (RFC 1950) / deflate (RFC 1951) compressor.
+     *
+     * Matches are found with a hash chain over a 32K window, and every block
+     * gets its own Huffman tables. Level only trades how hard the matcher
+     * looks against speed; the output is always a valid zlib stream.
+     */
+    namespace Deflate
+    {
+        enum class Level
+        {
+            Store,   // No compression, just framing
+            Fast,    // Shortest hash chains, no lazy matching
+            Default, // Medium chains with lazy matching
+            Best     // Long chains with lazy matching
+        };
+
+        constexpr Size WINDOW = 32768;
+        constexpr Size MIN_MATCH = 3;
+        constexpr Size MAX_MATCH = 258;
+        constexpr Size MAX_BITS = 15;
+
+        constexpr Size LITERALS = 286;
+        constexpr Size DISTANCES = 30;
+        constexpr Size END_OF_BLOCK = 256;
+
+        constexpr UInt16 LENGTH_BASE[29] = {
+            3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+        };
+
+        constexpr UInt8 LENGTH_EXTRA[29] = {
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+            3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+        };
+
+        constexpr UInt16 DISTANCE_BASE[30] = {
+            1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+            513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+        };
+
+        constexpr UInt8 DISTANCE_EXTRA[30] = {
+            0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+            7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+        };
+
+        // Order code length code lengths are sent in
+        constexpr UInt8 CODE_LENGTH_ORDER[19] = {
+            16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+        };
+
+        // Index into LENGTH_BASE for a match length
+        Size length_code(const Size length)
+        {
+            if(length == MAX_MATCH) return 28;
+
+            const Size x = length - MIN_MATCH;
+            if(x < 8) return x;
+
+            const Size b = std::bit_width(x) - 1;
+            return 4 * (b - 1) + ((x >> (b - 2)) & 3);
+        }
+
+        // Index into DISTANCE_BASE for a match distance
+        Size distance_code(const Size distance)
+        {
+            const Size x = distance - 1;
+            if(x < 4) return x;
+
+            const Size b = std::bit_width(x) - 1;
+            return 2 * b + ((x >> (b - 1)) & 1);
+        }
+
+        UInt32 adler32(const UInt8* data, const Size size, UInt32 adler = 1)
+        {
+            constexpr UInt32 MOD = 65521;
+            constexpr Size BLOCK = 5552; // Most bytes before the sums can overflow
+
+            UInt32 a = adler & 0xffff, b = adler >> 16;
+            for(Size i = 0; i < size;)
+            {
+                const Size end = std::min(size, i + BLOCK);
+                for(; i < end; ++i) { a += data[i]; b += a; }
+                a %= MOD; b %= MOD;
+            }
+
+            return (b << 16) | a;
+        }
+
+        // Packs bits least significant first, as deflate expects
+        class BitWriter
+        {
+        private:
+            std::vector<UInt8>& _out;
+            UInt64 _buffer;
+            Size _count;
+
+        public:
+            BitWriter(std::vector<UInt8>& out) : _out{out}, _buffer{0}, _count{0} {}
+
+            void put(const UInt32 bits, const Size n)
+            {
+                _buffer |= UInt64(bits) << _count;
+                _count += n;
+                while(_count >= 8)
+                {
+                    _out.push_back(UInt8(_buffer));
+                    _buffer >>= 8;
+                    _count -= 8;
+                }
+            }
+
+            void align()
+            {
+                if(_count > 0) _out.push_back(UInt8(_buffer));
+                _buffer = 0;
+                _count = 0;
+            }
+
+            std::vector<UInt8>& bytes() { return _out; }
+        };
+
+        /**
+         * Code lengths for a Huffman code over freq, no longer than limit.
+         * Too long codes are shortened by moving leaves up the tree until the
+         * code is complete again, then handed out by frequency.
+         */
+        void huffman_lengths(const UInt32* freq, const Size n, const Size limit, UInt8* lengths)
+        {
+            std::fill(lengths, lengths + n, 0);
+
+            std::vector<std::pair<UInt32, UInt16>> symbols;
+            for(Size i = 0; i < n; ++i)
+                if(freq[i] > 0) symbols.emplace_back(freq[i], UInt16(i));
+
+            if(symbols.empty()) return;
+            if(symbols.size() == 1) { lengths[symbols[0].second] = 1; return; }
+
+            std::sort(symbols.begin(), symbols.end());
+
+            // Two queue Huffman construction: leaves are sorted and new nodes
+            // are created in increasing weight, so both stay sorted
+            const Size m = symbols.size();
+            std::vector<UInt64> weight(2 * m - 1);
+            std::vector<Size> parent(2 * m - 1, 0);
+            for(Size i = 0; i < m; ++i) weight[i] = symbols[i].first;
+
+            Size leaf = 0, node = m;
+            const auto smallest = [&](Size next) {
+                if(leaf < m && (node >= next || weight[leaf] <= weight[node])) return leaf++;
+                return node++;
+            };
+
+            for(Size next = m; next < 2 * m - 1; ++next)
+            {
+                const Size a = smallest(next);
+                const Size b = smallest(next);
+                weight[next] = weight[a] + weight[b];
+                parent[a] = parent[b] = next;
+            }
+
+            std::vector<Size> depth(2 * m - 1, 0);
+            std::array<Size, MAX_BITS + 1> count{};
+            for(Size i = 2 * m - 1; i-- > 0;)
+            {
+                if(i != 2 * m - 2) depth[i] = depth[parent[i]] + 1;
+                if(i < m) ++count[std::min(depth[i], limit)];
+            }
+
+            // Repair the Kraft sum after clamping depths to limit
+            UInt32 total = 0;
+            for(Size len = 1; len <= limit; ++len)
+                total += UInt32(count[len]) << (limit - len);
+
+            while(total > (UInt32(1) << limit))
+            {
+                --count[limit];
+                for(Size len = limit - 1; len > 0; --len)
+                {
+                    if(count[len] > 0)
+                    {
+                        --count[len];
+                        count[len + 1] += 2;
+                        break;
+                    }
+                }
+                --total;
+            }
+
+            // Rarest symbols get the longest codes
+            Size i = 0;
+            for(Size len = limit; len > 0; --len)
+                for(Size k = 0; k < count[len]; ++k)
+                    lengths[symbols[i++].second] = UInt8(len);
+        }
+
+        // Canonical codes for lengths, bit reversed for BitWriter
+        void huffman_codes(const UInt8* lengths, const Size n, UInt16* codes)
+        {
+            std::array<UInt16, MAX_BITS + 2> next{};
+            std::array<UInt16, MAX_BITS + 1> count{};
+            for(Size i = 0; i < n; ++i) ++count[lengths[i]];
+            count[0] = 0;
+
+            for(Size len = 1; len <= MAX_BITS; ++len)
+                next[len + 1] = (next[len] + count[len]) << 1;
+
+            for(Size i = 0; i < n; ++i)
+            {
+                const Size len = lengths[i];
+                if(len == 0) { codes[i] = 0; continue; }
+
+                UInt16 code = next[len]++, reversed = 0;
+                for(Size b = 0; b < len; ++b) { reversed = (reversed << 1) | (code & 1); code >>= 1; }
+                codes[i] = reversed;
+            }
+        }
+
+        class Compressor
+        {
+        private:
+            // Literals are stored as is; matches set MATCH and pack the
+            // length above the distance
+            constexpr static UInt32 MATCH = UInt32(1) << 31;
+            constexpr static Size BLOCK_TOKENS = Size(1) << 16;
+
+            constexpr static Size HASH_BITS = 15;
+            constexpr static Size HASH_SIZE = Size(1) << HASH_BITS;
+
+            Size _chain;
+            bool _lazy;
+
+            std::vector<Int32> _head, _prev;
+            std::vector<UInt32> _tokens;
+
+        public:
+            Compressor(const Level level)
+                : _chain{level == Level::Fast ? 4u : level == Level::Default ? 32u : 256u}
+                , _lazy{level != Level::Fast}
+                , _head(HASH_SIZE, -1)
+                , _prev(WINDOW, -1)
+                , _tokens{} {}
+
+        private:
+            static Size hash(const UInt8* p)
+            {
+                const UInt32 v = UInt32(p[0]) | (UInt32(p[1]) << 8) | (UInt32(p[2]) << 16);
+                return (v * 2654435761u) >> (32 - HASH_BITS);
+            }
+
+            void insert(const UInt8* data, const Size pos)
+            {
+                const Size h = hash(data + pos);
+                _prev[pos & (WINDOW - 1)] = _head[h];
+                _head[h] = Int32(pos);
+            }
+
+            // Longest match for pos against earlier positions, 0 if none
+            Size find(const UInt8* data, const Size size, const Size pos, Size& distance) const
+            {
+                const Size limit = std::min(MAX_MATCH, size - pos);
+                if(limit < MIN_MATCH) return 0;
+
+                Size best = MIN_MATCH - 1;
+                Int32 candidate = _head[hash(data + pos)];
+
+                for(Size chain = _chain; candidate >= 0 && chain > 0; --chain)
+                {
+                    const Size dist = pos - candidate;
+                    if(dist == 0 || dist > WINDOW) break;
+
+                    const UInt8* a = data + pos;
+                    const UInt8* b = data + candidate;
+                    if(b[best] == a[best])
+                    {
+                        Size len = 0;
+                        while(len < limit && a[len] == b[len]) ++len;
+
+                        if(len > best)
+                        {
+                            best = len;
+                            distance = dist;
+                            if(len == limit) break;
+                        }
+                    }
+
+                    const Int32 next = _prev[candidate & (WINDOW - 1)];
+                    if(next >= candidate) break;
+                    candidate = next;
+                }
+
+                return best >= MIN_MATCH ? best : 0;
+            }
+
+            void write_block(BitWriter& out, const bool last) const
+            {
+                std::array<UInt32, LITERALS> lit_freq{};
+                std::array<UInt32, DISTANCES> dist_freq{};
+
+                for(const UInt32 token : _tokens)
+                {
+                    if(token & MATCH)
+                    {
+                        ++lit_freq[257 + length_code((token >> 16) & 0x1ff)];
+                        ++dist_freq[distance_code(token & 0xffff)];
+                    }
+                    else ++lit_freq[token];
+                }
+                lit_freq[END_OF_BLOCK] = 1;
+
+                std::array<UInt8, LITERALS + DISTANCES> lengths{};
+                UInt8* lit_len = lengths.data();
+                UInt8* dist_len = lengths.data() + LITERALS;
+                huffman_lengths(lit_freq.data(), LITERALS, MAX_BITS, lit_len);
+                huffman_lengths(dist_freq.data(), DISTANCES, MAX_BITS, dist_len);
+                if(std::all_of(dist_len, dist_len + DISTANCES, [](UInt8 l) { return l == 0; })) dist_len[0] = 1;
+
+                Size hlit = LITERALS, hdist = DISTANCES;
+                while(hlit > 257 && lit_len[hlit - 1] == 0) --hlit;
+                while(hdist > 1 && dist_len[hdist - 1] == 0) --hdist;
+
+                // Run length code the two sets of lengths back to back
+                std::vector<UInt8> all(lit_len, lit_len + hlit);
+                all.insert(all.end(), dist_len, dist_len + hdist);
+
+                std::vector<std::pair<UInt8, UInt8>> runs; // symbol, extra bits value
+                for(Size i = 0; i < all.size();)
+                {
+                    const UInt8 len = all[i];
+                    Size run = 1;
+                    while(i + run < all.size() && all[i + run] == len) ++run;
+                    i += run;
+
+                    if(len == 0)
+                    {
+                        while(run >= 11) { const Size r = std::min<Size>(run, 138); runs.emplace_back(18, r - 11); run -= r; }
+                        if(run >= 3) { runs.emplace_back(17, run - 3); run = 0; }
+                    }
+                    else
+                    {
+                        runs.emplace_back(len, 0); --run;
+                        while(run >= 3) { const Size r = std::min<Size>(run, 6); runs.emplace_back(16, r - 3); run -= r; }
+                    }
+
+                    while(run-- > 0) runs.emplace_back(len, 0);
+                }
+
+                std::array<UInt32, 19> clen_freq{};
+                for(const auto& run : runs) ++clen_freq[run.first];
+
+                std::array<UInt8, 19> clen_len{};
+                std::array<UInt16, 19> clen_code{};
+                huffman_lengths(clen_freq.data(), 19, 7, clen_len.data());
+                huffman_codes(clen_len.data(), 19, clen_code.data());
+
+                Size hclen = 19;
+                while(hclen > 4 && clen_len[CODE_LENGTH_ORDER[hclen - 1]] == 0) --hclen;
+
+                std::array<UInt16, LITERALS> lit_code{};
+                std::array<UInt16, DISTANCES> dist_code{};
+                huffman_codes(lit_len, LITERALS, lit_code.data());
+                huffman_codes(dist_len, DISTANCES, dist_code.data());
+
+                out.put(last ? 1 : 0, 1);
+                out.put(2, 2);
+                out.put(hlit - 257, 5);
+                out.put(hdist - 1, 5);
+                out.put(hclen - 4, 4);
+
+                for(Size i = 0; i < hclen; ++i)
+                    out.put(clen_len[CODE_LENGTH_ORDER[i]], 3);
+
+                for(const auto& run : runs)
+                {
+                    out.put(clen_code[run.first], clen_len[run.first]);
+                    if(run.first == 16) out.put(run.second, 2);
+                    if(run.first == 17) out.put(run.second, 3);
+                    if(run.first == 18) out.put(run.second, 7);
+                }
+
+                for(const UInt32 token : _tokens)
+                {
+                    if(token & MATCH)
+                    {
+                        const Size length = (token >> 16) & 0x1ff;
+                        const Size distance = token & 0xffff;
+                        const Size lc = length_code(length);
+                        const Size dc = distance_code(distance);
+
+                        out.put(lit_code[257 + lc], lit_len[257 + lc]);
+                        out.put(length - LENGTH_BASE[lc], LENGTH_EXTRA[lc]);
+                        out.put(dist_code[dc], dist_len[dc]);
+                        out.put(distance - DISTANCE_BASE[dc], DISTANCE_EXTRA[dc]);
+                    }
+                    else out.put(lit_code[token], lit_len[token]);
+                }
+
+                out.put(lit_code[END_OF_BLOCK], lit_len[END_OF_BLOCK]);
+            }
+
+        public:
+            void compress(const UInt8* data, const Size size, BitWriter& out)
+            {
+                _tokens.clear();
+                _tokens.reserve(BLOCK_TOKENS);
+
+                const auto match = [](Size length, Size distance) {
+                    return MATCH | UInt32(length << 16) | UInt32(distance);
+                };
+
+                Size pos = 0;
+                while(pos < size)
+                {
+                    Size distance = 0;
+                    Size length = find(data, size, pos, distance);
+
+                    if(length > 0 && _lazy && length < MAX_MATCH && pos + 1 < size)
+                    {
+                        // Prefer a literal here if the next byte starts a longer match
+                        Size next_distance = 0;
+                        const Size next = find(data, size, pos + 1, next_distance);
+                        if(next > length)
+                        {
+                            _tokens.push_back(data[pos]);
+                            if(pos + MIN_MATCH <= size) insert(data, pos);
+                            ++pos;
+                            length = next;
+                            distance = next_distance;
+                        }
+                    }
+
+                    const Size step = length > 0 ? length : 1;
+                    _tokens.push_back(length > 0 ? match(length, distance) : data[pos]);
+
+                    for(Size i = 0; i < step; ++i, ++pos)
+                        if(pos + MIN_MATCH <= size) insert(data, pos);
+
+                    if(_tokens.size() >= BLOCK_TOKENS)
+                    {
+                        write_block(out, false);
+                        _tokens.clear();
+                    }
+                }
+
+                write_block(out, true);
+                _tokens.clear();
+            }
+        };
+
+        void store(const UInt8* data, const Size size, BitWriter& out)
+        {
+            constexpr Size MAX_STORED = 65535;
+
+            Size pos = 0;
+            do
+            {
+                const Size length = std::min(MAX_STORED, size - pos);
+                out.put(pos + length == size ? 1 : 0, 1);
+                out.put(0, 2);
+                out.align();
+                out.put(length, 16);
+                out.put(~length & 0xffff, 16);
+
+                std::vector<UInt8>& bytes = out.bytes();
+                bytes.insert(bytes.end(), data + pos, data + pos + length);
+                pos += length;
+            } while(pos < size);
+        }
+
+        // Appends a complete zlib stream holding data to out
+        void zlib_compress(const UInt8* data, const Size size, std::vector<UInt8>& out, const Level level = Level::Default)
+        {
+            out.push_back(0x78);
+            out.push_back(0x01);
+
+            BitWriter bits(out);
+            if(level == Level::Store) store(data, size, bits);
+            else Compressor(level).compress(data, size, bits);
+            bits.align();
+
+            const UInt32 adler = adler32(data, size);
+            out.push_back(UInt8(adler >> 24));
+            out.push_back(UInt8(adler >> 16));
+            out.push_back(UInt8(adler >> 8));
+            out.push_back(UInt8(adler >> 0));
+        }
+    }
+}
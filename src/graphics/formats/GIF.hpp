@@ -0,0 +1,523 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include <fstream> // std::ofstream
+#include <cstdio> // std::rename, std::remove
+#include <string> // std::string
+#include <vector> // std::vector
+#include <array> // std::array
+#include <algorithm> // std::partition, std::sort, std::equal
+#include <stdexcept> // std::runtime_error
+
+#include "../TypeNames.hpp"
+#include "../ThresholdMap.hpp"
+#include "../Parallel.hpp"
+#include "../MappedFile.hpp"
+#include "../Image.hpp"
+
+namespace SPGL
+{
+    namespace GIF
+    {
+        constexpr Size PALETTE_SIZE = 256;
+
+        // Colors are binned to 5 bits per channel for the palette builder
+        constexpr Size BIN_BITS = 5;
+        constexpr Size BINS = Size(1) << (3 * BIN_BITS);
+
+        using Palette = std::array<Color::Bytes, PALETTE_SIZE>;
+
+        Size bin(const UInt8 r, const UInt8 g, const UInt8 b)
+        {
+            constexpr Size SHIFT = 8 - BIN_BITS;
+            return (Size(r >> SHIFT) << (2 * BIN_BITS)) | (Size(g >> SHIFT) << BIN_BITS) | Size(b >> SHIFT);
+        }
+
+        /**
+         * Median cut over a 15 bit color histogram. The box with the most
+         * pixels times extent is split at its median along its longest axis
+         * until there are 256 boxes; each palette entry is the mean of the
+         * pixels in its box.
+         */
+        Palette median_cut(const Color::Bytes* pixels, const Size size)
+        {
+            struct Entry { UInt32 count; UInt64 sum[3]; UInt8 key[3]; };
+            struct Box { Size begin, end; UInt64 count; Size axis; int extent; };
+
+            std::vector<Entry> histogram(BINS, Entry{});
+            for(Size i = 0; i < size; ++i)
+            {
+                const Color::Bytes& bytes = pixels[i];
+                Entry& entry = histogram[bin(bytes.r, bytes.g, bytes.b)];
+                ++entry.count;
+                entry.sum[0] += bytes.r;
+                entry.sum[1] += bytes.g;
+                entry.sum[2] += bytes.b;
+            }
+
+            std::vector<Entry> entries;
+            for(Size i = 0; i < BINS; ++i)
+            {
+                if(histogram[i].count == 0) continue;
+                Entry entry = histogram[i];
+                entry.key[0] = UInt8(i >> (2 * BIN_BITS));
+                entry.key[1] = UInt8((i >> BIN_BITS) & ((1 << BIN_BITS) - 1));
+                entry.key[2] = UInt8(i & ((1 << BIN_BITS) - 1));
+                entries.push_back(entry);
+            }
+
+            const auto make_box = [&](Size begin, Size end) {
+                Box box{begin, end, 0, 0, 0};
+                int lo[3] = {255, 255, 255}, hi[3] = {0, 0, 0};
+                for(Size i = begin; i < end; ++i)
+                {
+                    box.count += entries[i].count;
+                    for(Size c = 0; c < 3; ++c)
+                    {
+                        lo[c] = std::min<int>(lo[c], entries[i].key[c]);
+                        hi[c] = std::max<int>(hi[c], entries[i].key[c]);
+                    }
+                }
+                for(Size c = 0; c < 3; ++c)
+                    if(hi[c] - lo[c] > box.extent) { box.extent = hi[c] - lo[c]; box.axis = c; }
+                return box;
+            };
+
+            std::vector<Box> boxes;
+            if(!entries.empty()) boxes.push_back(make_box(0, entries.size()));
+
+            while(boxes.size() < PALETTE_SIZE)
+            {
+                Size pick = boxes.size();
+                UInt64 best = 0;
+                for(Size i = 0; i < boxes.size(); ++i)
+                {
+                    const UInt64 score = boxes[i].count * UInt64(boxes[i].extent);
+                    if(boxes[i].end - boxes[i].begin >= 2 && score > best) { best = score; pick = i; }
+                }
+                if(pick == boxes.size()) break;
+
+                // Median along the axis from a count per key, then partition;
+                // the split value stays below the top so neither half is empty
+                const Box box = boxes[pick];
+                UInt64 counts[1 << BIN_BITS] = {};
+                int lo = (1 << BIN_BITS) - 1, hi = 0;
+                for(Size i = box.begin; i < box.end; ++i)
+                {
+                    const int key = entries[i].key[box.axis];
+                    counts[key] += entries[i].count;
+                    lo = std::min(lo, key);
+                    hi = std::max(hi, key);
+                }
+
+                int median = lo;
+                for(UInt64 total = counts[lo]; median < hi - 1 && 2 * total < box.count; total += counts[++median]);
+
+                const Size split = std::partition(entries.begin() + box.begin, entries.begin() + box.end,
+                    [&](const Entry& e) { return e.key[box.axis] <= median; }) - entries.begin();
+
+                boxes[pick] = make_box(box.begin, split);
+                boxes.push_back(make_box(split, box.end));
+            }
+
+            Palette palette{};
+            for(Size i = 0; i < boxes.size(); ++i)
+            {
+                UInt64 sum[3] = {0, 0, 0};
+                for(Size e = boxes[i].begin; e < boxes[i].end; ++e)
+                    for(Size c = 0; c < 3; ++c) sum[c] += entries[e].sum[c];
+
+                palette[i] = Color::Bytes(
+                    UInt8(sum[0] / boxes[i].count),
+                    UInt8(sum[1] / boxes[i].count),
+                    UInt8(sum[2] / boxes[i].count)
+                );
+            }
+
+            return palette;
+        }
+
+        // Packs variable width LZW codes least significant bit first into
+        // 255 byte sub-blocks
+        class CodeWriter
+        {
+        private:
+            std::vector<UInt8>& _out;
+            std::vector<UInt8> _block;
+            UInt32 _buffer;
+            Size _count;
+
+        public:
+            CodeWriter(std::vector<UInt8>& out) : _out{out}, _block{}, _buffer{0}, _count{0} {}
+
+            void put(const UInt32 code, const Size bits)
+            {
+                _buffer |= code << _count;
+                _count += bits;
+                while(_count >= 8) { byte(UInt8(_buffer)); _buffer >>= 8; _count -= 8; }
+            }
+
+            void finish()
+            {
+                if(_count > 0) byte(UInt8(_buffer));
+                flush();
+                _out.push_back(0);
+            }
+
+        private:
+            void byte(const UInt8 b)
+            {
+                _block.push_back(b);
+                if(_block.size() == 255) flush();
+            }
+
+            void flush()
+            {
+                if(_block.empty()) return;
+                _out.push_back(UInt8(_block.size()));
+                _out.insert(_out.end(), _block.begin(), _block.end());
+                _block.clear();
+            }
+        };
+
+        // GIF flavoured LZW with 8 bit symbols and codes up to 12 bits
+        void lzw(const UInt8* indices, const Size size, std::vector<UInt8>& out)
+        {
+            constexpr UInt32 CLEAR = 256, END = 257, MAX_CODES = 4096;
+            constexpr Size TABLE = 8192; // Open addressing, more than twice MAX_CODES
+
+            std::vector<Int32> keys(TABLE), codes(TABLE);
+            const auto reset = [&] { std::fill(keys.begin(), keys.end(), -1); };
+
+            out.push_back(8); // Minimum code size
+            CodeWriter writer(out);
+
+            reset();
+            UInt32 next = END + 1;
+            Size bits = 9;
+            writer.put(CLEAR, bits);
+
+            if(size == 0) { writer.put(END, bits); writer.finish(); return; }
+
+            Int32 prefix = indices[0];
+            for(Size i = 1; i < size; ++i)
+            {
+                const Int32 key = (prefix << 8) | indices[i];
+                Size slot = (UInt32(key) * 2654435761u) >> (32 - 13);
+                while(keys[slot] != -1 && keys[slot] != key) slot = (slot + 1) & (TABLE - 1);
+
+                if(keys[slot] == key) { prefix = codes[slot]; continue; }
+
+                writer.put(prefix, bits);
+
+                if(next < MAX_CODES)
+                {
+                    keys[slot] = key;
+                    codes[slot] = next;
+                    if(next == (UInt32(1) << bits) && bits < 12) ++bits;
+                    ++next;
+                }
+                else
+                {
+                    writer.put(CLEAR, bits);
+                    reset();
+                    next = END + 1;
+                    bits = 9;
+                }
+
+                prefix = indices[i];
+            }
+
+            writer.put(prefix, bits);
+            writer.put(END, bits);
+            writer.finish();
+        }
+
+        /**
+         * Animated GIF written one frame at a time, so memory use does not
+         * grow with the length of the animation. Every frame gets its own
+         * median cut palette and is ordered dithered against blue noise,
+         * which keeps the noise from crawling between frames.
+         */
+        class Writer
+        {
+        private:
+            std::ofstream _file;
+            Size _width, _height;
+            Size _delay;
+            Color::RepT _spread;
+
+            // Reused between frames
+            Image _linear;
+            std::vector<Color::Bytes> _pixels;
+            std::vector<UInt16> _bins;
+            std::vector<UInt8> _indices;
+            std::vector<UInt8> _used;
+            std::vector<UInt8> _lookup;
+            std::vector<UInt8> _buffer;
+
+        public:
+            // delay is in hundredths of a second, spread is the size of the
+            // dither offset (0 to disable)
+            Writer(const std::string& file_name, const Size width, const Size height,
+                   const Size delay = 10, const Color::RepT spread = 1.0 / 16.0)
+                : _file{file_name, std::ios::binary | std::ios::trunc}
+                , _width{width}, _height{height}
+                , _delay{delay}
+                , _spread{spread}
+                , _linear{}, _pixels{}, _bins{}, _indices{}
+                , _used(BINS), _lookup(BINS)
+                , _buffer{}
+            {
+                const UInt8 header[] = {
+                    'G', 'I', 'F', '8', '9', 'a',
+                    UInt8(width), UInt8(width >> 8), UInt8(height), UInt8(height >> 8),
+                    0, 0, 0, // No global color table
+
+                    // Loop forever
+                    0x21, 0xff, 11, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0',
+                    3, 1, 0, 0, 0
+                };
+
+                _file.write(reinterpret_cast<const char*>(header), sizeof(header));
+                if(!_file) throw std::runtime_error("Unable to write \"" + file_name + "\"");
+            }
+
+            Writer(const Writer&) = delete;
+            Writer& operator=(const Writer&) = delete;
+
+            Size delay() const { return _delay; }
+            Color::RepT spread() const { return _spread; }
+
+            ~Writer() { close(); }
+
+        public:
+            bool good() const { return _file.good(); }
+
+            // Image must be width x height; other layouts are made Linear
+            // first. Throws if the frame can't be written.
+            void add_frame(const Image& input)
+            {
+                if(!_file.is_open()) return;
+
+                if(input.width() != _width || input.height() != _height)
+                    throw std::runtime_error("GIF frames must be " + std::to_string(_width) + "x" + std::to_string(_height)
+                        + ", not " + std::to_string(input.width()) + "x" + std::to_string(input.height()));
+
+                if(input.layout() != Layout::Linear) input.to_layout(Layout::Linear, _linear);
+                const Image& image = input.layout() == Layout::Linear ? input : _linear;
+
+                const Size size = _width * _height;
+                _pixels.resize(size);
+                _bins.resize(size);
+                _indices.resize(size);
+
+                // Pixels as bytes for the palette, and the bin each one lands
+                // in once dithered
+                const ThresholdMap& noise = ThresholdMap::BlueNoise();
+                Parallel::for_range(0, _height, [&](Size b, Size e) {
+                    for(Size y = b; y < e; ++y)
+                    for(Size x = 0; x < _width; ++x)
+                    {
+                        const Color& in = image[y * _width + x];
+                        const Color::RepT offset = (noise(x, y) - 0.5) * _spread;
+                        const Color::Bytes bytes = Color(in.r + offset, in.g + offset, in.b + offset);
+                        _pixels[y * _width + x] = in;
+                        _bins[y * _width + x] = UInt16(bin(bytes.r, bytes.g, bytes.b));
+                    }
+                });
+
+                const Palette palette = median_cut(_pixels.data(), size);
+                nearest(palette);
+
+                for(Size i = 0; i < size; ++i) _indices[i] = _lookup[_bins[i]];
+
+                _buffer.clear();
+                const UInt8 frame[] = {
+                    // Graphic control extension: leave frame in place, delay
+                    0x21, 0xf9, 4, 0x04, UInt8(_delay), UInt8(_delay >> 8), 0, 0,
+
+                    // Image descriptor with a 256 color local table
+                    0x2c, 0, 0, 0, 0,
+                    UInt8(_width), UInt8(_width >> 8), UInt8(_height), UInt8(_height >> 8),
+                    0x87
+                };
+                _buffer.insert(_buffer.end(), frame, frame + sizeof(frame));
+
+                for(const Color::Bytes& color : palette)
+                {
+                    _buffer.push_back(color.r);
+                    _buffer.push_back(color.g);
+                    _buffer.push_back(color.b);
+                }
+
+                lzw(_indices.data(), _indices.size(), _buffer);
+                write(_buffer.data(), _buffer.size());
+            }
+
+            // The blocks add_frame() wrote for the last frame. They stand
+            // alone, so they can be written again with add_encoded().
+            const std::vector<UInt8>& last_frame() const { return _buffer; }
+
+            void add_encoded(const UInt8* data, const Size size)
+            {
+                if(!_file.is_open()) return;
+                write(data, size);
+            }
+
+            void close()
+            {
+                if(!_file.is_open()) return;
+                _file.put(0x3b);
+                _file.close();
+            }
+
+        private:
+            void write(const UInt8* data, const Size size)
+            {
+                _file.write(reinterpret_cast<const char*>(data), size);
+                if(!_file) throw std::runtime_error("Unable to write GIF frame");
+            }
+
+            // Fills _lookup with the nearest palette entry to the center of
+            // every bin a pixel landed in. The palette is searched outward in
+            // order of green, stopping once green alone is too far away.
+            void nearest(const Palette& palette)
+            {
+                std::fill(_used.begin(), _used.end(), 0);
+                for(const UInt16 b : _bins) _used[b] = 1;
+
+                std::array<UInt8, PALETTE_SIZE> order;
+                for(Size p = 0; p < PALETTE_SIZE; ++p) order[p] = UInt8(p);
+                std::sort(order.begin(), order.end(), [&](UInt8 a, UInt8 b) { return palette[a].g < palette[b].g; });
+
+                Parallel::for_range(0, BINS, [&](Size b, Size e) {
+                    constexpr int MASK = (1 << BIN_BITS) - 1, SHIFT = 8 - BIN_BITS, HALF = 1 << (SHIFT - 1);
+
+                    for(Size i = b; i < e; ++i)
+                    {
+                        if(!_used[i]) continue;
+
+                        const int r = (int((i >> (2 * BIN_BITS)) & MASK) << SHIFT) + HALF;
+                        const int g = (int((i >> BIN_BITS) & MASK) << SHIFT) + HALF;
+                        const int bl = (int(i & MASK) << SHIFT) + HALF;
+
+                        const auto distance = [&](const Color::Bytes& c) {
+                            const int dr = r - c.r, dg = g - c.g, db = bl - c.b;
+                            return 2 * dr * dr + 4 * dg * dg + db * db;
+                        };
+
+                        const Size start = std::partition_point(order.begin(), order.end(),
+                            [&](UInt8 p) { return palette[p].g < g; }) - order.begin();
+
+                        int best = 1 << 30;
+                        for(Size p = start; p < PALETTE_SIZE; ++p)
+                        {
+                            const int dg = palette[order[p]].g - g;
+                            if(4 * dg * dg >= best) break;
+                            const int dist = distance(palette[order[p]]);
+                            if(dist < best) { best = dist; _lookup[i] = order[p]; }
+                        }
+                        for(Size p = start; p-- > 0;)
+                        {
+                            const int dg = g - palette[order[p]].g;
+                            if(4 * dg * dg >= best) break;
+                            const int dist = distance(palette[order[p]]);
+                            if(dist < best) { best = dist; _lookup[i] = order[p]; }
+                        }
+                    }
+                }, 256);
+            }
+        };
+
+        // Does the work of merge(), straight into output
+        bool merge_into(const std::vector<std::string>& inputs, const std::string& output)
+        {
+            std::ofstream file(output, std::ios::binary | std::ios::trunc);
+            if(!file || inputs.empty()) return false;
+
+            // Logical screen width and height of the first input
+            UInt8 screen[4] = {};
+
+            for(Size n = 0; n < inputs.size(); ++n)
+            {
+                const MappedFile input(inputs[n]);
+                const UInt8* data = input.data();
+                const Size size = input.size();
+
+                if(size < 13 || !std::equal(data, data + 6, "GIF89a")) return false;
+
+                // Every shard must be drawn at the same size
+                if(n == 0) std::copy(data + 6, data + 10, screen);
+                else if(!std::equal(data + 6, data + 10, screen)) return false;
+
+                // Header, screen descriptor and any global color table
+                Size pos = 13;
+                if(data[10] & 0x80) pos += 3 * (Size(2) << (data[10] & 7));
+                if(n == 0) file.write(reinterpret_cast<const char*>(data), pos);
+
+                // Data sub-blocks, up to and including the terminator
+                const auto sub_blocks = [&](Size at) {
+                    while(at < size && data[at] != 0) at += data[at] + 1;
+                    return at + 1;
+                };
+
+                while(pos < size && data[pos] != 0x3b)
+                {
+                    const Size start = pos;
+                    bool keep = true;
+
+                    if(data[pos] == 0x21 && pos + 1 < size)
+                    {
+                        keep = n == 0 || data[pos + 1] != 0xff;
+                        pos = sub_blocks(pos + 2);
+                    }
+                    else if(data[pos] == 0x2c && pos + 10 < size)
+                    {
+                        const UInt8 flags = data[pos + 9];
+                        pos += 10;
+                        if(flags & 0x80) pos += 3 * (Size(2) << (flags & 7));
+                        pos = sub_blocks(pos + 1);
+                    }
+                    else return false;
+
+                    if(pos > size) return false;
+                    if(keep) file.write(reinterpret_cast<const char*>(data + start), pos - start);
+                }
+            }
+
+            file.put(0x3b);
+            return bool(file);
+        }
+
+        /**
+         * Joins animations written by Writer with the same size into one,
+         * in order, without decoding them. Each frame carries its own
+         * palette and timing, so frame blocks are copied as they are; only
+         * the first file's header and loop extension are kept. Fails if
+         * the inputs' screen sizes differ.
+         *
+         * The result is built next to output and renamed over it, so a
+         * failed merge leaves any earlier output alone.
+         */
+        bool merge(const std::vector<std::string>& inputs, const std::string& output)
+        {
+            const std::string temp_name = output + ".part";
+            if(!merge_into(inputs, temp_name)) { std::remove(temp_name.c_str()); return false; }
+            return std::rename(temp_name.c_str(), output.c_str()) == 0;
+        }
+    }
+}
@@ -0,0 +1,280 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include <vector> // std::vector
+#include <array> // std::array
+#include <algorithm> // std::max, std::fill
+
+#include "../TypeNames.hpp"
+#include "Deflate.hpp"
+
+namespace SPGL
+{
+    // Decompressor for the streams written by Deflate, or anything else
+    // that follows RFC 1950 / 1951
+    namespace Deflate
+    {
+        // Reads bits least significant first. Past the end of the data it
+        // reads zeros; overrun() says whether any of those were used.
+        class BitReader
+        {
+        private:
+            const UInt8* _data;
+            Size _size, _pos;
+            UInt64 _buffer;
+            Size _count;
+
+        public:
+            BitReader(const UInt8* data, const Size size)
+                : _data{data}, _size{size}, _pos{0}, _buffer{0}, _count{0} {}
+
+            // Makes at least 56 bits available to peek
+            void refill()
+            {
+                while(_count <= 56)
+                {
+                    _buffer |= UInt64(_pos < _size ? _data[_pos] : 0) << _count;
+                    ++_pos;
+                    _count += 8;
+                }
+            }
+
+            UInt32 peek(const Size n) const { return UInt32(_buffer & ((UInt64(1) << n) - 1)); }
+            void consume(const Size n) { _buffer >>= n; _count -= n; }
+
+            UInt32 get(const Size n)
+            {
+                refill();
+                const UInt32 bits = peek(n);
+                consume(n);
+                return bits;
+            }
+
+            void align() { consume(_count % 8); }
+
+            // Drops anything buffered and continues from byte pos
+            void seek(const Size pos) { _pos = pos; _buffer = 0; _count = 0; }
+
+            // Position of the next unread byte, once aligned
+            Size position() const { return _pos - _count / 8; }
+            bool overrun() const { return position() > _size; }
+        };
+
+        // Single level lookup over the longest code: entries hold
+        // (symbol << 4) | length, with length 0 for unused codes
+        class HuffmanTable
+        {
+        private:
+            std::vector<UInt16> _table;
+            Size _bits;
+
+        public:
+            HuffmanTable() : _table{}, _bits{0} {}
+
+            bool build(const UInt8* lengths, const Size n)
+            {
+                std::array<UInt16, MAX_BITS + 1> count{};
+                for(Size i = 0; i < n; ++i) ++count[lengths[i]];
+                count[0] = 0;
+
+                _bits = 1;
+                for(Size len = 1; len <= MAX_BITS; ++len) if(count[len]) _bits = len;
+
+                // Over subscribed codes can't be decoded
+                int left = 1;
+                for(Size len = 1; len <= MAX_BITS; ++len)
+                {
+                    left = (left << 1) - count[len];
+                    if(left < 0) return false;
+                }
+
+                std::array<UInt16, 288> codes{};
+                huffman_codes(lengths, n, codes.data());
+
+                _table.assign(Size(1) << _bits, 0);
+                for(Size i = 0; i < n; ++i)
+                {
+                    const Size len = lengths[i];
+                    if(len == 0) continue;
+
+                    const UInt16 entry = UInt16((i << 4) | len);
+                    for(Size fill = codes[i]; fill < _table.size(); fill += Size(1) << len)
+                        _table[fill] = entry;
+                }
+
+                return true;
+            }
+
+            // Needs a refilled reader; returns -1 for an unused code
+            int decode(BitReader& in) const
+            {
+                const UInt16 entry = _table[in.peek(_bits)];
+                if((entry & 15) == 0) return -1;
+                in.consume(entry & 15);
+                return entry >> 4;
+            }
+        };
+
+        /**
+         * Appends the data in a raw deflate stream to out. size_hint, if
+         * known, avoids growing the output. Returns false for a corrupt or
+         * truncated stream.
+         */
+        bool inflate(const UInt8* data, const Size size, std::vector<UInt8>& out, const Size size_hint = 0)
+        {
+            BitReader in(data, size);
+            HuffmanTable literals, distances;
+
+            Size pos = out.size();
+            out.resize(std::max(pos + size_hint, pos + 4 * size + 1024));
+
+            const auto reserve = [&](Size n) {
+                if(pos + n > out.size()) out.resize(std::max(pos + n, 2 * out.size()));
+            };
+
+            for(bool last = false; !last;)
+            {
+                last = in.get(1);
+                const UInt32 type = in.get(2);
+
+                if(type == 0)
+                {
+                    in.align();
+                    const UInt32 length = in.get(16);
+                    if((in.get(16) ^ 0xffff) != length) return false;
+
+                    const Size start = in.position();
+                    if(start + length > size) return false;
+
+                    reserve(length);
+                    std::copy(data + start, data + start + length, out.begin() + pos);
+                    pos += length;
+                    in.seek(start + length);
+                    continue;
+                }
+
+                if(type == 1)
+                {
+                    std::array<UInt8, 288 + 32> lengths{};
+                    std::fill(lengths.begin(), lengths.begin() + 144, 8);
+                    std::fill(lengths.begin() + 144, lengths.begin() + 256, 9);
+                    std::fill(lengths.begin() + 256, lengths.begin() + 280, 7);
+                    std::fill(lengths.begin() + 280, lengths.begin() + 288, 8);
+                    std::fill(lengths.begin() + 288, lengths.end(), 5);
+
+                    literals.build(lengths.data(), 288);
+                    distances.build(lengths.data() + 288, 32);
+                }
+                else if(type == 2)
+                {
+                    const Size n_literals = in.get(5) + 257;
+                    const Size n_distances = in.get(5) + 1;
+                    const Size n_lengths = in.get(4) + 4;
+
+                    std::array<UInt8, 19> code_lengths{};
+                    for(Size i = 0; i < n_lengths; ++i)
+                        code_lengths[CODE_LENGTH_ORDER[i]] = in.get(3);
+
+                    HuffmanTable lengths_table;
+                    if(!lengths_table.build(code_lengths.data(), 19)) return false;
+
+                    std::array<UInt8, 288 + 32> lengths{};
+                    for(Size i = 0; i < n_literals + n_distances;)
+                    {
+                        in.refill();
+                        const int symbol = lengths_table.decode(in);
+                        if(symbol < 0) return false;
+
+                        if(symbol < 16) { lengths[i++] = symbol; continue; }
+
+                        UInt8 value = 0;
+                        Size repeat = 0;
+                        if(symbol == 16)
+                        {
+                            if(i == 0) return false;
+                            value = lengths[i - 1];
+                            repeat = 3 + in.get(2);
+                        }
+                        else if(symbol == 17) repeat = 3 + in.get(3);
+                        else repeat = 11 + in.get(7);
+
+                        if(i + repeat > n_literals + n_distances) return false;
+                        while(repeat--) lengths[i++] = value;
+                    }
+
+                    if(lengths[END_OF_BLOCK] == 0) return false;
+                    if(!literals.build(lengths.data(), n_literals)) return false;
+                    if(!distances.build(lengths.data() + n_literals, n_distances)) return false;
+                }
+                else return false;
+
+                for(;;)
+                {
+                    // One refill covers a length, a distance, and their extra bits
+                    in.refill();
+                    const int symbol = literals.decode(in);
+                    if(symbol < 0) return false;
+
+                    if(symbol < 256)
+                    {
+                        reserve(1);
+                        out[pos++] = UInt8(symbol);
+                        continue;
+                    }
+
+                    if(symbol == END_OF_BLOCK) break;
+                    if(symbol > 285) return false;
+
+                    const Size code = symbol - 257;
+                    const Size length = LENGTH_BASE[code] + in.peek(LENGTH_EXTRA[code]);
+                    in.consume(LENGTH_EXTRA[code]);
+
+                    const int dcode = distances.decode(in);
+                    if(dcode < 0 || dcode >= 30) return false;
+                    const Size distance = DISTANCE_BASE[dcode] + in.peek(DISTANCE_EXTRA[dcode]);
+                    in.consume(DISTANCE_EXTRA[dcode]);
+
+                    if(distance > pos) return false;
+
+                    reserve(length);
+                    UInt8* to = out.data() + pos;
+                    const UInt8* from = to - distance;
+                    for(Size i = 0; i < length; ++i) to[i] = from[i];
+                    pos += length;
+                }
+
+                if(in.overrun()) return false;
+            }
+
+            out.resize(pos);
+            return true;
+        }
+
+        // Appends the data in a zlib stream to out and checks its Adler-32
+        bool zlib_decompress(const UInt8* data, const Size size, std::vector<UInt8>& out, const Size size_hint = 0)
+        {
+            if(size < 6) return false;
+            if((data[0] & 0x0f) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20)) return false;
+
+            const Size start = out.size();
+            if(!inflate(data + 2, size - 6, out, size_hint)) return false;
+
+            const UInt8* tail = data + size - 4;
+            const UInt32 expected = (UInt32(tail[0]) << 24) | (UInt32(tail[1]) << 16) | (UInt32(tail[2]) << 8) | tail[3];
+            return adler32(out.data() + start, out.size() - start) == expected;
+        }
+    }
+}
@@ -0,0 +1,355 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include <iostream> // std::ostream
+#include <fstream> // std::ofstream
+#include <string> // std::string
+#include <vector> // std::vector
+#include <array> // std::array
+#include <cstdlib> // std::abs
+#include <algorithm> // std::equal, std::min
+
+#include "../TypeNames.hpp"
+#include "../Parallel.hpp"
+#include "../math/FastMath.hpp"
+#include "../Image.hpp"
+#include "Deflate.hpp"
+#include "Inflate.hpp"
+
+namespace SPGL
+{
+    namespace PNG
+    {
+        enum class Filter : UInt8
+        {
+            None = 0,
+            Sub = 1,
+            Up = 2,
+            Average = 3,
+            Paeth = 4,
+            Adaptive = 5 // Choose per row
+        };
+
+        constexpr UInt8 SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        constexpr Size CHANNELS = 3;
+
+        UInt32 crc32(const UInt8* data, const Size size, UInt32 crc = 0)
+        {
+            static const std::array<UInt32, 256> table = [] {
+                std::array<UInt32, 256> result{};
+                for(UInt32 n = 0; n < 256; ++n)
+                {
+                    UInt32 c = n;
+                    for(int k = 0; k < 8; ++k) c = (c & 1) ? (0xedb88320u ^ (c >> 1)) : (c >> 1);
+                    result[n] = c;
+                }
+                return result;
+            }();
+
+            crc = ~crc;
+            for(Size i = 0; i < size; ++i)
+                crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+            return ~crc;
+        }
+
+        UInt8 paeth(const int a, const int b, const int c)
+        {
+            const int p = a + b - c;
+            const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+            if(pa <= pb && pa <= pc) return a;
+            if(pb <= pc) return b;
+            return c;
+        }
+
+        // Writes filter(row) to out[0, n), given the row above (zeros for the
+        // first row). bpp bytes to the left of the row count as zero.
+        void filter_row(const Filter filter, const UInt8* row, const UInt8* above, UInt8* out, const Size n, const Size bpp)
+        {
+            for(Size i = 0; i < n; ++i)
+            {
+                const int a = i >= bpp ? row[i - bpp] : 0;
+                const int b = above[i];
+                const int c = i >= bpp ? above[i - bpp] : 0;
+
+                switch(filter)
+                {
+                    case Filter::Sub: out[i] = row[i] - a; break;
+                    case Filter::Up: out[i] = row[i] - b; break;
+                    case Filter::Average: out[i] = row[i] - ((a + b) >> 1); break;
+                    case Filter::Paeth: out[i] = row[i] - paeth(a, b, c); break;
+                    default: out[i] = row[i]; break;
+                }
+            }
+        }
+
+        // The usual heuristic: the filter whose output, read as signed
+        // bytes, has the smallest sum of magnitudes. trial holds n bytes.
+        void filter_adaptive(const UInt8* row, const UInt8* above, UInt8* out, UInt8* trial, const Size n, const Size bpp)
+        {
+            Size best_cost = ~Size(0);
+
+            for(UInt8 f = 0; f < UInt8(Filter::Adaptive); ++f)
+            {
+                filter_row(Filter(f), row, above, trial, n, bpp);
+
+                Size cost = 0;
+                for(Size i = 0; i < n; ++i) cost += std::abs(int(Int8(trial[i])));
+
+                if(cost < best_cost)
+                {
+                    best_cost = cost;
+                    out[-1] = f;
+                    std::copy(trial, trial + n, out);
+                }
+            }
+        }
+
+        void write_chunk(std::ostream& file, const char* type, const UInt8* data, const Size size)
+        {
+            const auto write_u32 = [&](UInt32 v) {
+                const UInt8 bytes[4] = { UInt8(v >> 24), UInt8(v >> 16), UInt8(v >> 8), UInt8(v) };
+                file.write(reinterpret_cast<const char*>(bytes), 4);
+            };
+
+            write_u32(UInt32(size));
+            file.write(type, 4);
+            file.write(reinterpret_cast<const char*>(data), size);
+
+            const UInt32 crc = crc32(data, size, crc32(reinterpret_cast<const UInt8*>(type), 4));
+            write_u32(crc);
+        }
+
+        // 8 bit RGB PNG of a Linear layout image
+        void write(std::ostream& file, const Image& image,
+                   const Deflate::Level level = Deflate::Level::Fast,
+                   const Filter filter = Filter::Adaptive)
+        {
+            const Size width = image.width(), height = image.height();
+            const Size stride = CHANNELS * width;
+
+            std::vector<UInt8> raw(stride * height);
+            std::vector<UInt8> filtered((stride + 1) * height);
+
+            Parallel::for_range(0, height, [&](Size b, Size e) {
+                Math::quantize(PPM::channels(image) + b * stride, &raw[b * stride], (e - b) * stride, 255.0);
+            });
+
+            const std::vector<UInt8> zeros(stride, 0);
+            Parallel::for_range(0, height, [&](Size b, Size e) {
+                std::vector<UInt8> trial(stride);
+                for(Size y = b; y < e; ++y)
+                {
+                    const UInt8* row = &raw[y * stride];
+                    const UInt8* above = y > 0 ? row - stride : zeros.data();
+                    UInt8* out = &filtered[y * (stride + 1) + 1];
+
+                    if(filter == Filter::Adaptive) filter_adaptive(row, above, out, trial.data(), stride, CHANNELS);
+                    else { out[-1] = UInt8(filter); filter_row(filter, row, above, out, stride, CHANNELS); }
+                }
+            });
+
+            std::vector<UInt8> compressed;
+            Deflate::zlib_compress(filtered.data(), filtered.size(), compressed, level);
+
+            const UInt8 header[13] = {
+                UInt8(width >> 24), UInt8(width >> 16), UInt8(width >> 8), UInt8(width),
+                UInt8(height >> 24), UInt8(height >> 16), UInt8(height >> 8), UInt8(height),
+                8, // Bit depth
+                2, // Color type: RGB
+                0, 0, 0 // Deflate, standard filters, no interlace
+            };
+
+            file.write(reinterpret_cast<const char*>(SIGNATURE), sizeof(SIGNATURE));
+            write_chunk(file, "IHDR", header, sizeof(header));
+            write_chunk(file, "IDAT", compressed.data(), compressed.size());
+            write_chunk(file, "IEND", nullptr, 0);
+        }
+
+        bool save(const std::string& file_name, const Image& image,
+                  const Deflate::Level level = Deflate::Level::Fast,
+                  const Filter filter = Filter::Adaptive)
+        {
+            std::ofstream file(file_name, std::ios::binary | std::ios::trunc);
+            if(!file) return false;
+
+            write(file, image, level, filter);
+            return bool(file);
+        }
+
+        // Undoes filter on row, given the unfiltered row above
+        void unfilter_row(const Filter filter, UInt8* row, const UInt8* above, const Size n, const Size bpp)
+        {
+            switch(filter)
+            {
+                case Filter::Sub:
+                    for(Size i = bpp; i < n; ++i) row[i] += row[i - bpp];
+                    break;
+
+                case Filter::Up:
+                    for(Size i = 0; i < n; ++i) row[i] += above[i];
+                    break;
+
+                case Filter::Average:
+                    for(Size i = 0; i < bpp; ++i) row[i] += above[i] >> 1;
+                    for(Size i = bpp; i < n; ++i) row[i] += (row[i - bpp] + above[i]) >> 1;
+                    break;
+
+                case Filter::Paeth:
+                    for(Size i = 0; i < bpp; ++i) row[i] += above[i];
+                    for(Size i = bpp; i < n; ++i) row[i] += paeth(row[i - bpp], above[i], above[i - bpp]);
+                    break;
+
+                default: break;
+            }
+        }
+
+        /**
+         * The unfiltered scanlines of a PNG, still at the file's own bit
+         * depth, with pixels converted to colors only as they are read.
+         * Keeps an 8 bit RGBA image at 4 bytes a pixel instead of the 24 of
+         * a decoded Image.
+         */
+        struct Raster
+        {
+            Size width = 0, height = 0, depth = 0, type = 0, samples = 0, stride = 0;
+            Float64 scale = 0.0;
+            std::array<Color, 256> palette{};
+            std::vector<UInt8> raw;
+
+            bool empty() const { return width == 0; }
+
+            // Row y counts down from the top, as stored
+            Color pixel(const Size x, const Size y) const
+            {
+                const UInt8* row = &raw[y * (stride + 1) + 1];
+                const auto sample = [&](Size i) -> Size {
+                    if(depth == 8) return row[i];
+                    if(depth == 16) return (row[2 * i] << 8) | row[2 * i + 1];
+                    const Size bit = i * depth;
+                    return (row[bit / 8] >> (8 - depth - bit % 8)) & ((1 << depth) - 1);
+                };
+
+                const Size i = x * samples;
+                if(type == 3) return palette[sample(i)];
+                if(samples <= 2) return Color(sample(i) * scale, sample(i) * scale, sample(i) * scale);
+                return Color(sample(i) * scale, sample(i + 1) * scale, sample(i + 2) * scale);
+            }
+
+            void decode_row(const Size y, Color* out) const
+            { for(Size x = 0; x < width; ++x) out[x] = pixel(x, y); }
+        };
+
+        /**
+         * Reads a non interlaced PNG of any bit depth and color type into a
+         * Raster. Alpha is kept in the raster but never read. Returns false
+         * and leaves raster untouched for anything it can't read.
+         */
+        bool read(const UInt8* data, const Size size, Raster& raster)
+        {
+            if(size < sizeof(SIGNATURE) || !std::equal(SIGNATURE, SIGNATURE + sizeof(SIGNATURE), data)) return false;
+
+            const auto read_u32 = [](const UInt8* p) {
+                return (UInt32(p[0]) << 24) | (UInt32(p[1]) << 16) | (UInt32(p[2]) << 8) | UInt32(p[3]);
+            };
+
+            Size width = 0, height = 0, depth = 0, type = 0;
+            std::vector<UInt8> compressed;
+            std::array<Color, 256> palette{};
+
+            for(Size pos = sizeof(SIGNATURE); pos + 12 <= size;)
+            {
+                const Size length = read_u32(data + pos);
+                const UInt8* type_name = data + pos + 4;
+                const UInt8* chunk = data + pos + 8;
+                if(pos + 12 + length > size) return false;
+                pos += 12 + length;
+
+                const auto is = [&](const char* name) { return std::equal(name, name + 4, type_name); };
+
+                if(is("IHDR"))
+                {
+                    if(length < 13) return false;
+                    width = read_u32(chunk);
+                    height = read_u32(chunk + 4);
+                    depth = chunk[8];
+                    type = chunk[9];
+                    if(chunk[10] != 0 || chunk[11] != 0 || chunk[12] != 0) return false; // Interlaced
+                }
+                else if(is("PLTE"))
+                {
+                    for(Size i = 0; i < std::min<Size>(length / 3, 256); ++i)
+                        palette[i] = Color::Bytes(chunk[3 * i], chunk[3 * i + 1], chunk[3 * i + 2]);
+                }
+                else if(is("IDAT")) compressed.insert(compressed.end(), chunk, chunk + length);
+                else if(is("IEND")) break;
+            }
+
+            // Samples per pixel for gray, -, RGB, palette, gray + alpha, -, RGBA
+            constexpr Size SAMPLES[7] = { 1, 0, 3, 1, 2, 0, 4 };
+            if(width == 0 || height == 0 || type > 6 || SAMPLES[type] == 0) return false;
+            if(depth != 1 && depth != 2 && depth != 4 && depth != 8 && depth != 16) return false;
+
+            const Size samples = SAMPLES[type];
+            const Size bpp = std::max<Size>(1, samples * depth / 8);
+            const Size stride = (width * samples * depth + 7) / 8;
+
+            std::vector<UInt8> raw;
+            if(!Deflate::zlib_decompress(compressed.data(), compressed.size(), raw, height * (stride + 1))) return false;
+            if(raw.size() < height * (stride + 1)) return false;
+
+            const std::vector<UInt8> zeros(stride, 0);
+            for(Size y = 0; y < height; ++y)
+            {
+                UInt8* row = &raw[y * (stride + 1)];
+                if(row[0] > UInt8(Filter::Paeth)) return false;
+                unfilter_row(Filter(row[0]), row + 1, y > 0 ? row + 1 - (stride + 1) : zeros.data(), stride, bpp);
+            }
+
+            raster.width = width;
+            raster.height = height;
+            raster.depth = depth;
+            raster.type = type;
+            raster.samples = samples;
+            raster.stride = stride;
+            raster.scale = 1.0 / Float64((Size(1) << depth) - 1);
+            raster.palette = palette;
+            raster.raw = std::move(raw);
+            return true;
+        }
+
+        /**
+         * Decodes a non interlaced PNG into a Linear layout image, or
+         * returns false and leaves image untouched.
+         *
+         * Inflating and unfiltering are inherently serial; converting the
+         * samples to colors runs in parallel over groups of rows.
+         */
+        bool decode(const UInt8* data, const Size size, Image& image)
+        {
+            Raster raster;
+            if(!read(data, size, raster)) return false;
+
+            Image result(raster.width, raster.height);
+            Parallel::for_range(0, raster.height, [&](Size b, Size e) {
+                for(Size y = b; y < e; ++y)
+                    raster.decode_row(y, result.data() + y * raster.width);
+            });
+
+            image = std::move(result);
+            return true;
+        }
+    }
+}
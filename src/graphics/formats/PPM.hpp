@@ -0,0 +1,233 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include <iostream> // std::ostream
+#include <sstream> // std::ostringstream
+#include <string> // std::string
+#include <vector> // std::vector
+#include <charconv> // std::from_chars, std::to_chars
+#include <cctype> // std::isspace
+#include <algorithm> // std::min
+
+#include "../TypeNames.hpp"
+#include "../Parallel.hpp"
+#include "../math/FastMath.hpp"
+#include "../Image.hpp"
+
+namespace SPGL
+{
+    namespace PPM
+    {
+        const char* MAGIC_HEADER = "P6\n";
+        const Size COLOR_DEPTH = 255;
+
+        enum class Encoding
+        {
+            Binary, // P6
+            Ascii   // P3
+        };
+
+        static_assert(sizeof(Color) == 3 * sizeof(Color::RepT), "Color must be three packed channels");
+
+        // All channels of a Linear layout image, row by row
+        inline const Color::RepT* channels(const Image& image)
+        { return reinterpret_cast<const Color::RepT*>(image.data()); }
+
+        /**
+         * Writes image as a PPM. depth is the largest channel value, up to
+         * 65535; anything above 255 stores two bytes per channel, most
+         * significant first.
+         *
+         * Rows are converted in parallel into one buffer which is then
+         * written with a single call.
+         */
+        void write(std::ostream& file, const Image& image,
+                   const Size depth = COLOR_DEPTH,
+                   const Encoding encoding = Encoding::Binary)
+        {
+            if(image.layout() != Layout::Linear)
+            { write(file, image.to_layout(Layout::Linear), depth, encoding); return; }
+
+            const Size width = image.width(), height = image.height();
+            const Size stride = 3 * width;
+            const Float64 max = Float64(depth);
+
+            file << (encoding == Encoding::Ascii ? "P3\n" : MAGIC_HEADER);
+            file << width << ' ' << height << '\n';
+            file << depth << '\n';
+
+            std::vector<UInt16> values(stride * height);
+            Parallel::for_range(0, height, [&](Size b, Size e) {
+                Math::quantize(channels(image) + b * stride, &values[b * stride], (e - b) * stride, max);
+            });
+
+            std::vector<char> buffer;
+
+            if(encoding == Encoding::Ascii)
+            {
+                // At most 5 digits and a separator per value
+                buffer.resize(values.size() * 6);
+                char* out = buffer.data();
+                for(Size i = 0; i < values.size(); ++i)
+                {
+                    out = std::to_chars(out, buffer.data() + buffer.size(), values[i]).ptr;
+                    *out++ = (i + 1) % stride == 0 ? '\n' : ' ';
+                }
+                buffer.resize(out - buffer.data());
+            }
+            else if(depth > 0xff)
+            {
+                buffer.resize(2 * values.size());
+                for(Size i = 0; i < values.size(); ++i)
+                {
+                    buffer[2 * i + 0] = char(values[i] >> 8);
+                    buffer[2 * i + 1] = char(values[i]);
+                }
+            }
+            else
+            {
+                buffer.assign(values.begin(), values.end());
+            }
+
+            file.write(buffer.data(), buffer.size());
+        }
+
+        struct Header
+        {
+            Encoding encoding = Encoding::Binary;
+            Size width = 0, height = 0, depth = 0;
+            Size offset = 0; // Bytes before the pixel data
+
+            Size bytes() const { return depth > 0xff ? 2 : 1; }
+            Size stride() const { return 3 * width * bytes(); }
+        };
+
+        // Parses the header at the start of [data, data + size), skipping
+        // whitespace and # comments between fields
+        bool parse_header(const UInt8* data, const Size size, Header& header)
+        {
+            const char* in = reinterpret_cast<const char*>(data);
+            const char* const end = in + size;
+
+            const auto skip = [&] {
+                while(in < end && (std::isspace(UInt8(*in)) || *in == '#'))
+                    if(*in++ == '#') while(in < end && *in != '\n') ++in;
+            };
+
+            const auto number = [&](Size& value) {
+                skip();
+                const auto result = std::from_chars(in, end, value);
+                in = result.ptr;
+                return result.ec == std::errc{} && in < end && std::isspace(UInt8(*in));
+            };
+
+            skip();
+            if(end - in < 2 || in[0] != 'P' || (in[1] != '6' && in[1] != '3')) return false;
+            header.encoding = in[1] == '6' ? Encoding::Binary : Encoding::Ascii;
+            in += 2;
+
+            if(!number(header.width) || !number(header.height) || !number(header.depth)) return false;
+            if(header.width == 0 || header.height == 0 || header.depth == 0 || header.depth > 0xffff) return false;
+
+            // A single whitespace separates the header from the pixels
+            header.offset = in + 1 - reinterpret_cast<const char*>(data);
+            return true;
+        }
+
+        // Converts rows [b, e) of binary pixel data, top row first, to colors
+        void decode_rows(const Header& header, const UInt8* pixels, const Size b, const Size e, Color* out)
+        {
+            const Float64 scale = 1.0 / Float64(header.depth);
+            const Size count = 3 * header.width * (e - b);
+            const UInt8* in = pixels + b * header.stride();
+
+            const auto channel = [&](Size i) -> Float64 {
+                return (header.bytes() == 2 ? (in[2 * i] << 8) | in[2 * i + 1] : in[i]) * scale;
+            };
+
+            for(Size i = 0; i < count; i += 3)
+                out[i / 3] = Color(channel(i + 0), channel(i + 1), channel(i + 2));
+        }
+
+        /**
+         * Decodes a P3 or P6 PPM with any depth up to 65535 into a Linear
+         * layout image. Returns false and leaves image untouched if the data
+         * is not a valid PPM.
+         */
+        bool decode(const UInt8* data, const Size size, Image& image)
+        {
+            Header header;
+            if(!parse_header(data, size, header)) return false;
+
+            const Size width = header.width, height = header.height;
+            Image result(width, height);
+
+            if(header.encoding == Encoding::Binary)
+            {
+                if(size < header.offset + header.stride() * height) return false;
+
+                Parallel::for_range(0, height, [&](Size b, Size e) {
+                    decode_rows(header, data + header.offset, b, e, result.data() + b * width);
+                });
+            }
+            else
+            {
+                const char* in = reinterpret_cast<const char*>(data) + header.offset;
+                const char* const end = reinterpret_cast<const char*>(data) + size;
+                const Float64 scale = 1.0 / Float64(header.depth);
+
+                for(Size i = 0; i < 3 * width * height; ++i)
+                {
+                    while(in < end && (std::isspace(UInt8(*in)) || *in == '#'))
+                        if(*in++ == '#') while(in < end && *in != '\n') ++in;
+
+                    UInt16 value = 0;
+                    const auto parsed = std::from_chars(in, end, value);
+                    if(parsed.ec != std::errc{}) return false;
+                    in = parsed.ptr;
+
+                    Color& color = result[i / 3];
+                    (i % 3 == 0 ? color.r : i % 3 == 1 ? color.g : color.b) = std::min(value * scale, 1.0);
+                }
+            }
+
+            image = std::move(result);
+            return true;
+        }
+
+        // Reads the rest of the stream as one PPM
+        bool read(std::istream& file, Image& image)
+        {
+            std::ostringstream buffer;
+            buffer << file.rdbuf();
+
+            const std::string data = std::move(buffer).str();
+            return decode(reinterpret_cast<const UInt8*>(data.data()), data.size(), image);
+        }
+    }
+
+    std::ostream& operator<<(std::ostream& file, const Image& image)
+    {
+        PPM::write(file, image);
+        return file;
+    }
+
+    std::istream& operator>>(std::istream& file, Image& image)
+    {
+        if(!PPM::read(file, image)) file.setstate(std::ios::failbit);
+        return file;
+    }
+}
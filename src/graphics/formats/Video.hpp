@@ -0,0 +1,142 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include <string> // std::string
+#include <vector> // std::vector
+#include <stdexcept> // std::runtime_error
+#include <cerrno> // errno
+
+#include <fcntl.h> // open
+#include <unistd.h> // write, close
+
+#include "../TypeNames.hpp"
+#include "../Parallel.hpp"
+#include "../math/FastMath.hpp"
+#include "../Image.hpp"
+#include "PPM.hpp"
+
+namespace SPGL
+{
+    // Uncompressed frames for piping straight into a video encoder
+    namespace Video
+    {
+        enum class Format
+        {
+            Y4M,  // YUV4MPEG2, 4:4:4 BT.601 studio range, one header for the stream
+            RGB24 // Bare 8 bit RGB frames, the reader has to know the size
+        };
+
+        /**
+         * Writes every frame to a file descriptor as soon as it arrives, so
+         * it works with stdout, pipes and FIFOs as well as regular files.
+         * Throws std::runtime_error if the other end goes away.
+         */
+        class Writer
+        {
+        private:
+            int _fd;
+            Format _format;
+            Size _width, _height;
+            std::vector<UInt8> _frame;
+
+        public:
+            // Takes ownership of fd
+            Writer(const int fd, const Format format, const Size width, const Size height, const Size fps = 10)
+                : _fd{fd}, _format{format}
+                , _width{width}, _height{height}
+                , _frame{}
+            {
+                if(_fd < 0) throw std::runtime_error("Unable to open video output");
+
+                if(_format == Format::Y4M)
+                {
+                    const std::string header = "YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height)
+                                             + " F" + std::to_string(fps) + ":1 Ip A1:1 C444\n";
+
+                    // The destructor won't run if the constructor throws
+                    try { put(reinterpret_cast<const UInt8*>(header.data()), header.size()); }
+                    catch(...) { ::close(_fd); throw; }
+                }
+            }
+
+            // A FIFO blocks here until something opens it for reading
+            Writer(const std::string& file_name, const Format format, const Size width, const Size height, const Size fps = 10)
+                : Writer(::open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644), format, width, height, fps) {}
+
+            Writer(const Writer&) = delete;
+            Writer& operator=(const Writer&) = delete;
+
+            ~Writer() { if(_fd >= 0) ::close(_fd); }
+
+        public:
+            // Image must be width x height and in Linear layout
+            void add_frame(const Image& image)
+            {
+                const Size pixels = _width * _height;
+                const Color::RepT* channels = PPM::channels(image);
+
+                if(_format == Format::RGB24)
+                {
+                    _frame.resize(3 * pixels);
+                    Parallel::for_range(0, _height, [&](Size b, Size e) {
+                        Math::quantize(channels + 3 * b * _width, &_frame[3 * b * _width], 3 * (e - b) * _width, 255.0);
+                    });
+
+                    put(_frame.data(), _frame.size());
+                    return;
+                }
+
+                constexpr char TAG[] = "FRAME\n";
+                const Size TAG_SIZE = sizeof(TAG) - 1;
+
+                // Planar Y, Cb, Cr after the frame tag
+                _frame.resize(TAG_SIZE + 3 * pixels);
+                std::copy(TAG, TAG + TAG_SIZE, _frame.begin());
+                UInt8* y_plane = &_frame[TAG_SIZE];
+                UInt8* cb_plane = y_plane + pixels;
+                UInt8* cr_plane = cb_plane + pixels;
+
+                const auto byte = [](Float64 v) { return UInt8(Math::clamp_max(Math::clamp_min(v + 0.5, 0.0), 255.5)); };
+
+                Parallel::for_range(0, _height, [&](Size b, Size e) {
+                    for(Size i = b * _width; i < e * _width; ++i)
+                    {
+                        const Float64 r = channels[3 * i + 0], g = channels[3 * i + 1], bl = channels[3 * i + 2];
+                        y_plane[i]  = byte( 16.0 +  65.481 * r + 128.553 * g +  24.966 * bl);
+                        cb_plane[i] = byte(128.0 -  37.797 * r -  74.203 * g + 112.000 * bl);
+                        cr_plane[i] = byte(128.0 + 112.000 * r -  93.786 * g -  18.214 * bl);
+                    }
+                });
+
+                put(_frame.data(), _frame.size());
+            }
+
+        private:
+            void put(const UInt8* data, Size size)
+            {
+                while(size > 0)
+                {
+                    const ssize_t written = ::write(_fd, data, size);
+                    if(written < 0 && errno == EINTR) continue;
+                    if(written <= 0) throw std::runtime_error("Video output closed");
+
+                    data += written;
+                    size -= written;
+                }
+            }
+        };
+    }
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+/**
+ * Copyright (c) 2022 Sam Belliveau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ */
+
+#include "../TypeNames.hpp"
+
+#include <bit>
+#include <cmath>
+
+namespace SPGL
+{
+    namespace Math
+    {
+        // max / min written without comparisons so the compiler can't split
+        // the surrounding loop into branches around the clamped constant
+        inline Float64 clamp_min(Float64 x, Float64 lo)
+        { return 0.5 * ((x + lo) + std::abs(x - lo)); }
+
+        inline Float64 clamp_max(Float64 x, Float64 hi)
+        { return 0.5 * ((x + hi) - std::abs(x - hi)); }
+
+        /**
+         * Approximate log2 / exp2 / pow for doubles.
+         *
+         * These are branch free and only use bit tricks, multiplies and a
+         * single division, so loops over arrays of channels vectorize.
+         *
+         * Error bounds (measured over x in [2^-40, 1], p in [1/4, 4]):
+         *  - fast_log2: absolute error < 2e-9
+         *  - fast_exp2: relative error < 1e-9
+         *  - fast_pow:  relative error < 2e-9 * (1 + |p * log2(x)|)
+         *
+         * fast_pow treats x <= 0 as 0, so fast_pow(0, p) = 0 for p > 0, which
+         * is all that color math needs. NaN is not handled.
+         */
+
+        inline Float64 fast_log2(Float64 x)
+        {
+            constexpr UInt64 MANTISSA = (UInt64(1) << 52) - 1;
+            constexpr UInt64 SQRT_HALF = 0x3fe6a09e667f3bcdull;
+            constexpr UInt64 ONE = 0x3ff0000000000000ull;
+            constexpr UInt64 TWO_52 = 0x4330000000000000ull;
+            constexpr Float64 K = 2.8853900817779268; // 2 / ln(2)
+
+            x = clamp_min(x, 2.2250738585072014e-308);
+
+            // Split into exponent and mantissa in [sqrt(0.5), sqrt(2))
+            const UInt64 bits = std::bit_cast<UInt64>(x) + (ONE - SQRT_HALF);
+            const Float64 exp = std::bit_cast<Float64>((bits >> 52) | TWO_52) - (4503599627370496.0 + 1023.0);
+            const Float64 m = std::bit_cast<Float64>((bits & MANTISSA) + SQRT_HALF);
+
+            // ln(m) = 2 atanh(t), t = (m - 1) / (m + 1), |t| < 0.1716
+            const Float64 t = (m - 1.0) / (m + 1.0);
+            const Float64 t2 = t * t;
+            const Float64 series = 1.0 + t2 * (1.0 / 3.0 + t2 * (1.0 / 5.0 + t2 * (1.0 / 7.0 + t2 * (1.0 / 9.0))));
+
+            return exp + K * t * series;
+        }
+
+        inline Float64 fast_exp2(Float64 x)
+        {
+            constexpr Float64 ROUND = 6755399441055744.0; // 1.5 * 2^52
+
+            x = clamp_min(x, -1020.0);
+            x = clamp_max(x, +1020.0);
+
+            // Round to nearest integer, leaving it in the low mantissa bits
+            const Float64 shifted = x + ROUND;
+            const Float64 n = shifted - ROUND;
+            const Float64 f = (x - n) * 0.6931471805599453; // ln(2)
+
+            // Taylor series for e^f, |f| < 0.347
+            const Float64 p = 1.0 + f * (1.0 + f * (1.0 / 2.0 + f * (1.0 / 6.0 + f * (1.0 / 24.0
+                            + f * (1.0 / 120.0 + f * (1.0 / 720.0 + f * (1.0 / 5040.0 + f * (1.0 / 40320.0))))))));
+
+            const UInt64 scale = (std::bit_cast<UInt64>(shifted) + 1023) << 52;
+            return p * std::bit_cast<Float64>(scale);
+        }
+
+        inline Float64 fast_pow(Float64 x, Float64 p)
+        {
+            x = clamp_min(x, 0.0);
+
+            // All ones unless x is zero
+            const UInt64 mask = ((std::bit_cast<UInt64>(x) - 1) >> 63) - 1;
+            const Float64 result = fast_exp2(p * fast_log2(x));
+            return std::bit_cast<Float64>(std::bit_cast<UInt64>(result) & mask);
+        }
+
+        // Raises every value in [in, in + n) to p, writing to out (may alias in)
+        inline void fast_pow(const Float64* in, Float64* out, Size n, Float64 p)
+        {
+            for(Size i = 0; i < n; ++i)
+                out[i] = fast_pow(in[i], p);
+        }
+
+        // Scales every value in [in, in + n) by max and rounds it to an
+        // integer in [0, max]. Like float_to_byte, but without std::lround,
+        // so whole rows convert in vector registers.
+        template<class Int>
+        inline void quantize(const Float64* in, Int* out, Size n, Float64 max)
+        {
+            for(Size i = 0; i < n; ++i)
+                out[i] = Int(Int32(clamp_max(clamp_min(in[i] * max + 0.5, 0.0), max + 0.5)));
+        }
+    }
+}
@@ -16,6 +16,7 @@
 
 #include "../TypeNames.hpp"
 #include "MathConstants.hpp"
+#include "Vector2D.hpp"
 
 #include <cmath>
 
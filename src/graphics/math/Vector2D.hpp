@@ -19,6 +19,7 @@
 #include <iostream>
 
 #include <cmath>
+#include <array>
 
 namespace SPGL
 {
@@ -11,7 +11,7 @@
   SYMTAB *s;
   struct light *l;
   struct constants *c;
-  struct command op[MAX_COMMANDS];
+  CommandList op;
   struct matrix *m;
   int lastop=0;
   int lineno=0;
@@ -793,16 +793,30 @@ extern "C" int yywrap()
 extern FILE *yyin;
 
 
-int main(int argc, char **argv) {
+void yyrestart(FILE *input_file);
+
+/* Fills op[] and symtab[] from a script, replacing what the last call left
+   there. Both are shared by every caller, so only one parse may run at a
+   time, and their contents must be copied out before the next one. */
+int parse_legacy(char *file_name) {
+
+  yyin = fopen(file_name,"r");
+  if (yyin == NULL) return 0;
 
-  yyin = fopen(argv[1],"r");
+  lastop = 0;
+  lastsym = 0;
+  symtab.clear();
+  yyrestart(yyin);
 
   yyparse();
-  //COMMENT OUT PRINT_PCODE AND UNCOMMENT
-  //MY_MAIN IN ORDER TO RUN YOUR CODE
+  fclose(yyin);
 
   //print_pcode();
-  my_main();
+  return 1;
+}
 
-  return 0;
+
+int main(int argc, char **argv) {
+
+  return my_main(argc, argv);
 }
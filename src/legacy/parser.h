@@ -1,10 +1,11 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <vector>
+
 #include "symtab.h"
 #include "matrix.h"
 
-#define MAX_COMMANDS 512
 
 extern int lastop;
 
@@ -126,8 +127,29 @@ struct command
 
 
 
-extern struct command op[MAX_COMMANDS];
+/* Commands in the order they were parsed. Writing past the end grows
+   the list, so scripts can be any length. Commands are stored one after
+   another and data() points at the first. */
+class CommandList
+{
+private:
+  std::vector<struct command> commands;
+
+public:
+  struct command &operator[](int i)
+  {
+    if (i >= (int)commands.size()) commands.resize(i + 1);
+    return commands[i];
+  }
+
+  const struct command &operator[](int i) const { return commands[i]; }
+
+  const struct command *data() const { return commands.data(); }
+};
+
+extern CommandList op;
 
 void print_pcode();
-void my_main();
+int parse_legacy(char *file_name);
+int my_main(int argc, char **argv);
 #endif
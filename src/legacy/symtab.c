@@ -8,7 +8,7 @@
 #include "symtab.h"
 #include "matrix.h"
 
-SYMTAB symtab[MAX_SYMBOLS];
+SymbolTable symtab;
 int lastsym = 0;
 
 
@@ -77,10 +77,6 @@ SYMTAB *add_symbol(char *name, int type, void *data)
   t = (SYMTAB *)lookup_symbol(name);
   if (t==NULL)
     {
-      if (lastsym >= MAX_SYMBOLS)
-        {
-          return NULL;
-        }
       t = (SYMTAB *)&(symtab[lastsym]);
       lastsym++;
     }
@@ -91,6 +87,7 @@ SYMTAB *add_symbol(char *name, int type, void *data)
 
   t->name = (char *)malloc(strlen(name)+1);
   strcpy(t->name,name);
+  symtab.add(t);
   t->type = type;
   switch (type)
     {
@@ -116,15 +113,7 @@ SYMTAB *add_symbol(char *name, int type, void *data)
 
 SYMTAB *lookup_symbol(char *name)
 {
-  int i;
-  for (i=0;i<lastsym;i++)
-    {
-      if (!strcmp(name,symtab[i].name))
-        {
-          return (SYMTAB *) &(symtab[i]);
-        }
-    }
-  return (SYMTAB *)NULL;
+  return symtab.find(name);
 }
 
 void set_value(SYMTAB *p, double value)
@@ -1,7 +1,11 @@
 #ifndef SYMTAB_H
 #define SYMTAB_H
 
-#define MAX_SYMBOLS 512
+#include <memory>
+#include <vector>
+#include <string_view>
+#include <unordered_map>
+
 #define SYM_MATRIX 1
 #define SYM_VALUE 2
 #define SYM_CONSTANTS 3
@@ -39,7 +43,39 @@ typedef struct
   } s;
 } SYMTAB;
 
-extern SYMTAB symtab[MAX_SYMBOLS];
+/* Symbols in the order they were added, found by name through a hash
+   index. They are allocated in blocks that never move, so SYMTAB
+   pointers held by commands stay valid as the table grows. */
+class SymbolTable
+{
+private:
+  static const int BLOCK_SIZE = 256;
+
+  std::vector<std::unique_ptr<SYMTAB[]>> blocks;
+  std::unordered_map<std::string_view, SYMTAB *> index;
+
+public:
+  SYMTAB &operator[](int i)
+  {
+    while (i >= (int)blocks.size() * BLOCK_SIZE)
+      blocks.push_back(std::make_unique<SYMTAB[]>(BLOCK_SIZE));
+    return blocks[i / BLOCK_SIZE][i % BLOCK_SIZE];
+  }
+
+  /* t->name must not change or be freed while t is in the table */
+  void add(SYMTAB *t) { index.emplace(t->name, t); }
+
+  /* Forgets every name, keeping the blocks to be filled again */
+  void clear() { index.clear(); }
+
+  SYMTAB *find(const char *name) const
+  {
+    auto found = index.find(name);
+    return found == index.end() ? NULL : found->second;
+  }
+};
+
+extern SymbolTable symtab;
 extern int lastsym;
 
 SYMTAB *lookup_symbol(char *name);
@@ -35,271 +35,263 @@
   =========================*/
 
 #include <iostream>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <filesystem>
+#include <chrono>
+#include <csignal>
+#include <unistd.h>
 
 #include "./legacy/parser.h"
 #include "./legacy/symtab.h"
 #include "./legacy/y.tab.h"
 #include "./legacy/matrix.h"
 
-#include "Engine.hpp"
+#include "Scene.hpp"
+#include "Daemon.hpp"
 
 using namespace SPGL;
 
-constexpr static Float kSegments = 1024.0;
+// Command line options
+struct Options
+{
+    Scene::Options render;
 
-void my_main() {
+    // Scripts to render, each as its own scene
+    std::vector<std::string> scripts;
 
-    print_symtab();
+    // Reads scripts with the flex / bison parser instead of MDL::load
+    bool legacy_parser = false;
 
-    std::string basename = "default";
-    int frames = 1;
+    // Renders scripts again whenever they change, until interrupted
+    bool watch = false;
 
-    std::unordered_map<std::string, std::vector<double>> table;
+    // Serves render jobs on this socket instead of rendering
+    std::string serve_path;
+    Size workers = Parallel::threads();
 
-    for (int i = 0; i < lastop; i++)
-    {
-        struct command& command = op[i];
+    // Hands scripts to the daemon on this socket instead of rendering them
+    std::string daemon_path;
+    int priority = 0;
+    UInt64 cancel = 0;
+};
 
-        switch(command.opcode)
-        {
-        case BASENAME: {
-            basename = command.op.basename.p->name;
-            std::cout << i << ": Basename = " << basename << std::endl;
-        }; break;
+Options parse_options(int argc, char **argv)
+{
+    Options options;
 
-        case FRAMES: {
-            frames = command.op.frames.num_frames;
-            std::cout << i << ": Number of Frames = " << frames << std::endl;
-        }; break;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
 
-        default: {} break;
+        if ((arg == "--y4m" || arg == "--rgb") && i + 1 < argc)
+        {
+            options.render.stream_format = arg == "--y4m" ? Video::Format::Y4M : Video::Format::RGB24;
+            options.render.stream_path = argv[++i];
+        }
+        else if (arg == "--jobs" && i + 1 < argc)
+        {
+            options.render.jobs = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--shard" && i + 1 < argc)
+        {
+            if (std::sscanf(argv[++i], "%d/%d", &options.render.shard, &options.render.shards) != 2
+            || options.render.shards < 1 || options.render.shard < 0 || options.render.shard >= options.render.shards)
+            {
+                std::cerr << "Expected --shard INDEX/COUNT, rendering everything\n";
+                options.render.shard = 0;
+                options.render.shards = 1;
+            }
+        }
+        else if (arg == "--merge" && i + 1 < argc)
+        {
+            options.render.merge = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--layout" && i + 1 < argc)
+        {
+            const std::string name = argv[++i];
+            if (const auto layout = SPGL::layout(name)) options.render.layout = *layout;
+            else std::cerr << "Expected --layout linear, tiled or morton, using linear\n";
+        }
+        else if (arg == "--cache" && i + 1 < argc)
+        {
+            options.render.cache_path = argv[++i];
+        }
+        else if (arg == "--cache-limit" && i + 1 < argc)
+        {
+            options.render.cache_limit = UInt64(std::max(1, std::atoi(argv[++i]))) << 20;
+        }
+        else if (arg == "--no-cache")
+        {
+            options.render.cache_path.clear();
+        }
+        else if (arg == "--legacy-parser")
+        {
+            options.legacy_parser = true;
+        }
+        else if (arg == "--watch")
+        {
+            options.watch = true;
+        }
+        else if (arg == "--serve" && i + 1 < argc)
+        {
+            options.serve_path = argv[++i];
+        }
+        else if (arg == "--workers" && i + 1 < argc)
+        {
+            options.workers = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--daemon" && i + 1 < argc)
+        {
+            options.daemon_path = argv[++i];
+        }
+        else if (arg == "--priority" && i + 1 < argc)
+        {
+            options.priority = std::atoi(argv[++i]);
+        }
+        else if (arg == "--cancel" && i + 1 < argc)
+        {
+            options.cancel = std::strtoull(argv[++i], nullptr, 10);
         }
+        else if (!arg.starts_with("--"))
+        {
+            options.scripts.push_back(arg);
+        }
+        else std::cerr << "Ignoring unknown option \"" << arg << "\"\n";
     }
 
-    for (int i = 0; i < lastop; i++)
-    {
-        struct command& command = op[i];
+    return options;
+}
 
-        if(command.opcode == VARY)
+// False if the script couldn't be loaded or rendered
+bool render(const std::string& script, const Options& options, Scene::State& state)
+{
+    try
+    {
+        const Scene scene = options.legacy_parser ? Scene::load_legacy(script) : Scene::load(script);
+        scene.render(options.render, state);
+        return true;
+    }
+    catch (const std::exception& error)
+    {
+        std::cerr << "Error: " << error.what() << "\n";
+        return false;
+    }
+}
+
+// Renders script each time it is written to. Engines, the static layer
+// and the hashes of saved frames carry over, so only what an edit changed
+// is drawn again.
+void watch(const std::string& script, const Options& options)
+{
+    Scene::State state;
+    state.incremental = true;
+
+    std::filesystem::file_time_type rendered{};
+    for (;;)
+    {
+        std::error_code error;
+        const auto modified = std::filesystem::last_write_time(script, error);
+        if (error || modified == rendered)
         {
-            std::vector<double> values;
-            for (int f = 0; f < frames; ++f) {
-                if (f <= command.op.vary.start_frame) 
-                { values.push_back(command.op.vary.start_val); }
-                else if (f >= command.op.vary.end_frame) 
-                { values.push_back(command.op.vary.end_val); }
-
-                else 
-                {
-                    double t = (f - command.op.vary.start_frame) / double(command.op.vary.end_frame - command.op.vary.start_frame);
-                    values.push_back(
-                        command.op.vary.start_val * (1.0 - t) + 
-                        command.op.vary.end_val * t
-                    );
-                }
-            }
-            table[command.op.vary.p->name] = values;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
         }
+
+        rendered = modified;
+
+        const auto start = std::chrono::steady_clock::now();
+        render(script, options, state);
+        const auto time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+        std::cerr << "Rendered " << script << " in " << time.count() << "ms, watching for changes...\n";
     }
-    
-    Engine engine(500, 500);
+}
 
-    for (int f = 0; f < frames; ++f)
+bool run(const std::string& script, const Options& options)
+{
+    // Runs until interrupted
+    if (options.watch)
     {
-        std::cerr << "Frame " << f << " / " << frames << "...";  
-        engine.reset();
-        for (int i = 0; i < lastop; i++) 
-        {
-            struct command& command = op[i];
+        watch(script, options);
+        return true;
+    }
 
-            switch(command.opcode)
-            {
-            case POP: {
-                engine.pop_transform();
-                } break;
-
-            case PUSH: {
-                engine.push_transform(engine.get_transform());
-                } break;
-
-            case LINE: {
-                engine.set_material(command.op.line.constants);
-
-                Vec3d a(command.op.line.p0);
-                Vec3d b(command.op.line.p0);
-                engine.draw_line(a, b);
-                } break;
-
-            case BOX: {
-                engine.set_material(command.op.box.constants);
-
-                Vec3d a(command.op.box.d0);
-                Vec3d b(command.op.box.d1);
-                b = a + b * Vec3d(+1, -1, -1);
-                
-                Vec3d b1(a.x, a.y, a.z), b2(b.x, a.y, a.z), b3(b.x, a.y, b.z), b4(a.x, a.y, b.z);
-                Vec3d t1(a.x, b.y, a.z), t2(b.x, b.y, a.z), t3(b.x, b.y, b.z), t4(a.x, b.y, b.z);
-
-                engine.draw_quad(b1, b2, b3, b4); engine.draw_quad(t4, t3, t2, t1);
-                engine.draw_quad(b2, b1, t1, t2); engine.draw_quad(b3, b2, t2, t3);
-                engine.draw_quad(b4, b3, t3, t4); engine.draw_quad(b1, b4, t4, t1);
-                } break;
-
-            case SPHERE: {
-                engine.set_material(command.op.sphere.constants);
-
-                Vec3d pos(command.op.sphere.d);
-                Float64 radius(command.op.sphere.r);
-
-                const Float64 dp = Math::PI / kSegments;
-                const Float64 dt = Math::PI / kSegments;
-                for(Float64 phi = 0.0; phi < Math::PI; phi += dp)
-                {
-                    for(Float64 theta = 0.0; theta <= Math::TAU; theta += dt)
-                    {
-                        Vec3d da = pos + radius * Vec3d(
-                            std::cos(phi),
-                            std::sin(phi) * std::cos(theta),
-                            std::sin(phi) * std::sin(theta)
-                        );
-
-                        Vec3d db = pos + radius * Vec3d(
-                            std::cos(phi + dp),
-                            std::sin(phi + dp) * std::cos(theta),
-                            std::sin(phi + dp) * std::sin(theta)
-                        );
-
-                        Vec3d dc = pos + radius * Vec3d(
-                            std::cos(phi + dp),
-                            std::sin(phi + dp) * std::cos(theta + dt),
-                            std::sin(phi + dp) * std::sin(theta + dt)
-                        );
-
-                        Vec3d dd = pos + radius * Vec3d(
-                            std::cos(phi),
-                            std::sin(phi) * std::cos(theta + dt),
-                            std::sin(phi) * std::sin(theta + dt)
-                        );
-
-                        engine.draw_quad(da, db, dc, dd);
-                    }
-                }
-                } break;
-
-            case TORUS: {
-                engine.set_material(command.op.torus.constants);
-
-                Vec3d pos(command.op.torus.d);
-                Float64 radius1(command.op.torus.r0);
-                Float64 radius2(command.op.torus.r1);
-
-                const Float64 dp = Math::TAU / kSegments;
-                const Float64 dt = Math::TAU / kSegments;
-                for(Float64 phi = 0.0; phi <= Math::TAU; phi += dp)
-                {
-                    for(Float64 theta = 0.0; theta <= Math::TAU; theta += dt)
-                    {
-                        Vec3d da = pos + Vec3d(
-                            radius2 * std::cos(phi) + radius1 * std::cos(phi) * std::cos(theta + dt),
-                            radius1 * std::sin(theta + dt),
-                            radius2 * std::sin(phi) + radius1 * std::sin(phi) * std::cos(theta + dt)
-                        );
-
-                        Vec3d db = pos + Vec3d(
-                            radius2 * std::cos(phi + dp) + radius1 * std::cos(phi + dp) * std::cos(theta + dt),
-                            radius1 * std::sin(theta + dt),
-                            radius2 * std::sin(phi + dp) + radius1 * std::sin(phi + dp) * std::cos(theta + dt)
-                        );
-
-                        Vec3d dc = pos + Vec3d(
-                            radius2 * std::cos(phi + dp) + radius1 * std::cos(phi + dp) * std::cos(theta),
-                            radius1 * std::sin(theta),
-                            radius2 * std::sin(phi + dp) + radius1 * std::sin(phi + dp) * std::cos(theta)
-                        );
-
-                        Vec3d dd = pos + Vec3d(
-                            radius2 * std::cos(phi) + radius1 * std::cos(phi) * std::cos(theta),
-                            radius1 * std::sin(theta),
-                            radius2 * std::sin(phi) + radius1 * std::sin(phi) * std::cos(theta)
-                        );
-
-                        engine.draw_quad(da, db, dc, dd);
-                    }
-                }
-                } break;
-            
-            case SCALE: {
-                Vec3d scale(command.op.scale.d);
-
-                if (command.op.scale.p != NULL
-                && table.contains(command.op.scale.p->name))
-                { scale *= table[command.op.scale.p->name][f]; }
-
-                engine.modify_transform(Mat4d::Scale(scale));
-                } break;
-
-            case MOVE: {
-                Vec3d translate(command.op.move.d);
-
-                if (command.op.move.p != NULL
-                && table.contains(command.op.move.p->name))
-                { translate *= table[command.op.move.p->name][f]; }
-
-                engine.modify_transform(Mat4d::Translation(translate));
-                } break;
-
-            case ROTATE: {
-                int axis = std::lround(command.op.rotate.axis);
-                Float64 theta(command.op.rotate.degrees);
-                theta = Math::PI * theta / 180.0;
-
-                if (command.op.rotate.p != NULL
-                && table.contains(command.op.rotate.p->name))
-                { theta *= table[command.op.rotate.p->name][f]; }
-
-                /**/ if(axis == 0) engine.modify_transform(Mat4d::RotX(theta));
-                else if(axis == 1) engine.modify_transform(Mat4d::RotY(theta));
-                else if(axis == 2) engine.modify_transform(Mat4d::RotZ(theta));
-                else std::cout << "Unknown Axis \"" << axis << "\". Ignoring...\n";
-
-                } break;
-
-            case DISPLAY: {
-                std::string temp_file_name = ".display_tmp_" + std::to_string(i) + ".ppm";
-                engine.save(temp_file_name);
-                std::system(("open " + temp_file_name).c_str());
-                } break;
-
-            case SAVE: {
-                engine.save(command.op.save.p->name);
-                } break;
-
-            default: {
-                std::cout << "Unknown OP Code: " << command.opcode;
-                } break;
-            }
+    Scene::State state;
+    return render(script, options, state);
+}
+
+int my_main(int argc, char **argv) {
+
+    Options options = parse_options(argc, argv);
+
+    try
+    {
+        if (!options.serve_path.empty())
+        {
+            RenderDaemon(options.serve_path, options.workers, options.render).run();
+            return EXIT_FAILURE;
         }
 
-        if (frames != 1)
+        if (!options.daemon_path.empty())
         {
-            char fname[100] = {};
-            sprintf(fname, "%s-%04d.png", basename.c_str(), f);
-            engine.save(std::string(fname));
+            bool ok = true;
+            if (options.cancel != 0)
+                ok = RenderDaemon::cancel(options.daemon_path, options.cancel) && ok;
+            if (!options.scripts.empty())
+                ok = RenderDaemon::submit(options.daemon_path, options.scripts, options.priority) && ok;
+            return ok ? EXIT_SUCCESS : EXIT_FAILURE;
         }
+    }
+    catch (const std::exception& error)
+    {
+        std::cerr << "Error: " << error.what() << "\n";
+        return EXIT_FAILURE;
+    }
 
-        std::cerr << "Done!\n";
+    if (options.scripts.empty())
+    {
+        std::cerr << "Error: Expected a script to run\n";
+        return EXIT_FAILURE;
     }
-    
-    if (frames != 1)
+
+    // Only one scene can write to a stream
+    if (options.scripts.size() > 1 && !options.render.stream_path.empty())
     {
-        std::string cmd = "convert -delay 10 ./";
-        cmd += basename;
-        cmd += "-*";
-        cmd += " ";
-        cmd += basename;
-        cmd += ".gif && rm ./";
-        cmd += basename;
-        cmd += "-*";
-        std::system(cmd.c_str());
+        std::cerr << "Error: Only one script can be streamed at a time\n";
+        return EXIT_FAILURE;
     }
-}
\ No newline at end of file
+
+    // A reader that stops early should end the render with an error, not kill it
+    if (!options.render.stream_path.empty())
+        std::signal(SIGPIPE, SIG_IGN);
+
+    // Frames on stdout can't share it with the log, which moves to stderr
+    if (options.render.stream_path == "-")
+    {
+        std::cout.flush();
+        std::fflush(stdout);
+        options.render.stream_fd = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
+
+    // Scenes share nothing, so every script after the first gets a thread
+    std::atomic<bool> ok{true};
+    std::vector<std::thread> others;
+    for (Size i = 1; i < options.scripts.size(); ++i)
+        others.emplace_back([&, i] { if (!run(options.scripts[i], options)) ok = false; });
+
+    if (!run(options.scripts.front(), options)) ok = false;
+
+    for (std::thread& thread : others) thread.join();
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
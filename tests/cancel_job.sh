@@ -0,0 +1,43 @@
+#!/bin/sh
+
+# Starts a render daemon, cancels a cached GIF render part way through,
+# and checks that the job reports "cancelled" and the daemon keeps serving.
+#
+# Usage: tests/cancel_job.sh [path to graphics_demo]
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+BIN=$(cd "$(dirname "${1:-$ROOT/bin/graphics_demo}")" && pwd)/$(basename "${1:-$ROOT/bin/graphics_demo}")
+
+WORK=$(mktemp -d)
+SOCKET=$WORK/daemon.sock
+trap 'kill $DAEMON 2>/dev/null; rm -rf "$WORK"' EXIT
+
+fail() { echo "FAIL: $1"; exit 1; }
+
+cd "$WORK" || exit 1
+ln -s "$ROOT/resources" resources
+cp "$ROOT/simple_anim.mdl" anim.mdl
+printf 'frames 2\nbasename short\nsphere 250 250 0 100\n' > short.mdl
+
+"$BIN" --serve "$SOCKET" --workers 1 --cache cache > daemon.log 2>&1 &
+DAEMON=$!
+
+for _ in 1 2 3 4 5 6 7 8 9 10; do [ -S "$SOCKET" ] && break; sleep 0.2; done
+[ -S "$SOCKET" ] || fail "daemon never started listening"
+
+"$BIN" --daemon "$SOCKET" anim.mdl > anim.out 2>&1 &
+CLIENT=$!
+
+# Cancel once a few frames are through
+for _ in $(seq 1 300); do [ "$(grep -c Done daemon.log)" -ge 3 ] && break; sleep 0.1; done
+[ "$(grep -c Done daemon.log)" -ge 3 ] || fail "the job never got going"
+
+"$BIN" --daemon "$SOCKET" --cancel 1 > cancel.out 2>&1 || fail "cancel was refused: $(cat cancel.out)"
+
+wait $CLIENT && fail "a cancelled job exited with success"
+grep -q "^cancelled 1$" anim.out || fail "expected \"cancelled 1\", got: $(cat anim.out)"
+
+kill -0 $DAEMON 2>/dev/null || fail "the daemon died: $(tail -n 5 daemon.log)"
+"$BIN" --daemon "$SOCKET" short.mdl > short.out 2>&1 || fail "the next job failed: $(cat short.out)"
+
+echo "PASS: cancel_job"